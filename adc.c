@@ -1,671 +1,1212 @@
-/*
- * This file is part of the W1209 firmware replacement project
- * (https://github.com/mister-grumbler/w1209-firmware).
- *
- * This program is free software: you can redistribute it and/or modify
- * it under the terms of the GNU General Public License as published by
- * the Free Software Foundation, version 3.
- *
- * This program is distributed in the hope that it will be useful, but
- * WITHOUT ANY WARRANTY; without even the implied warranty of
- * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
- * General Public License for more details.
- *
- * You should have received a copy of the GNU General Public License
- * along with this program. If not, see <http://www.gnu.org/licenses/>.
- */
-
-/**
- * Control functions for analog-to-digital converter (ADC).
- * The ADC1 interrupt (22) is used to get signal on end of convertion event.
- * The port D6 (pin 3) is used as analog input (AIN6).
- */
-
-#include "adc.h"
-#include "stm8s003/adc.h"
-#include "params.h"
-
-// Averaging bits
-#define ADC_AVERAGING_BITS      4
-
-#define ADC_RAW_32K_SIZE      (sizeof rawAdc32k / sizeof rawAdc32k[0])
-#define ADC_RAW_32K_BASE_TEMP 1110
-
-static unsigned char waitAdc = 1 ;
-
-/* Choose your suitable R2 resister constant. */
-#define R2 20000 // R2 = 20k [203] ohm (default)
-//#<OFF>#define R2 10000 // R2 = 10k [103] ohm
-//#<OFF>#define R2 5100 // R2 = 5.1k [512] ohm
-
-/* Choose your suitable B-constant of the RT NTC thermistor. */
-#define B3380K // RT NTC 10K that has B-constant = 3380K (default)
-//#<OFF>#define B3435K // RT NTC 10K that has B-constant = 3435K
-//#<OFF>#define B3950K // RT NTC 10K that has B-constant = 3950K
-
-/* Adc digital converter (Floating point probably be solved on compiling.) */
-#define adcDig32k(RT) (unsigned int)(32768.f*(RT)/((R2)+(RT)))
-
-#ifdef B3380K
-// The raw ADC 32k lookup table for the NTC RT 10K B-constant = 3380K.
-const unsigned int rawAdc32k[] = {
-    adcDig32k(790.3)    , // 111
-    adcDig32k(808.66)   , // 110
-    adcDig32k(827.54)   , // 109
-    adcDig32k(846.97)   , // 108
-    adcDig32k(866.96)   , // 107
-    adcDig32k(887.53)   , // 106
-    adcDig32k(908.702)  , // 105
-    adcDig32k(930.49)   , // 104
-    adcDig32k(952.93)   , // 103
-    adcDig32k(976.031)  , // 102
-    adcDig32k(999.82)   , // 101
-    adcDig32k(1024.32)  , // 100
-    adcDig32k(1049.56)  , // 99
-    adcDig32k(1075.56)  , // 98
-    adcDig32k(1102.35)  , // 97
-    adcDig32k(1129.96)  , // 96
-    adcDig32k(1158.41)  , // 95
-    adcDig32k(1187.75)  , // 94
-    adcDig32k(1217.99)  , // 93
-    adcDig32k(1249.17)  , // 92
-    adcDig32k(1281.33)  , // 91
-    adcDig32k(1314.5)   , // 90
-    adcDig32k(1348.72)  , // 89
-    adcDig32k(1384.03)  , // 88
-    adcDig32k(1420.47)  , // 87
-    adcDig32k(1458.08)  , // 86
-    adcDig32k(1496.9)   , // 85
-    adcDig32k(1536.98)  , // 84
-    adcDig32k(1578.37)  , // 83
-    adcDig32k(1621.12)  , // 82
-    adcDig32k(1665.27)  , // 81
-    adcDig32k(1710.89)  , // 80
-    adcDig32k(1758.03)  , // 79
-    adcDig32k(1806.74)  , // 78
-    adcDig32k(1857.1)   , // 77
-    adcDig32k(1909.16)  , // 76
-    adcDig32k(1962.99)  , // 75
-    adcDig32k(2018.66)  , // 74
-    adcDig32k(2076.25)  , // 73
-    adcDig32k(2135.83)  , // 72
-    adcDig32k(2197.47)  , // 71
-    adcDig32k(2261.28)  , // 70
-    adcDig32k(2327.32)  , // 69
-    adcDig32k(2395.7)   , // 68
-    adcDig32k(2466.5)   , // 67
-    adcDig32k(2539.84)  , // 66
-    adcDig32k(2615.81)  , // 65
-    adcDig32k(2694.52)  , // 64
-    adcDig32k(2776.09)  , // 63
-    adcDig32k(2860.64)  , // 62
-    adcDig32k(2948.3)   , // 61
-    adcDig32k(3039.19)  , // 60
-    adcDig32k(3133.45)  , // 59
-    adcDig32k(3231.24)  , // 58
-    adcDig32k(3332.69)  , // 57
-    adcDig32k(3438)     , // 56
-    adcDig32k(3547.27)  , // 55
-    adcDig32k(3660.73)  , // 54
-    adcDig32k(3778.55)  , // 53
-    adcDig32k(3900.92)  , // 52
-    adcDig32k(4028.04)  , // 51
-    adcDig32k(4160.14)  , // 50
-    adcDig32k(4297.43)  , // 49
-    adcDig32k(4440.14)  , // 48
-    adcDig32k(4588.53)  , // 47
-    adcDig32k(4742.86)  , // 46
-    adcDig32k(4903.4)   , // 45
-    adcDig32k(5070.44)  , // 44
-    adcDig32k(5244.3)   , // 43
-    adcDig32k(5425.23)  , // 42
-    adcDig32k(5613.6)   , // 41
-    adcDig32k(5809.87)  , // 40
-    adcDig32k(6014.28)  , // 39
-    adcDig32k(6227.27)  , // 38
-    adcDig32k(6449.24)  , // 37
-    adcDig32k(6680.6)   , // 36
-    adcDig32k(6921.92)  , // 35
-    adcDig32k(7173.58)  , // 34
-    adcDig32k(7436.12)  , // 33
-    adcDig32k(7710.1)   , // 32
-    adcDig32k(7996.05)  , // 31
-    adcDig32k(8294.61)  , // 30
-    adcDig32k(8606.4)   , // 29
-    adcDig32k(8932.11)  , // 28
-    adcDig32k(9272.43)  , // 27
-    adcDig32k(9628.1)   , // 26
-    adcDig32k(10000)    , // 25
-    adcDig32k(10388.9)  , // 24
-    adcDig32k(10795.7)  , // 23
-    adcDig32k(11221.3)  , // 22
-    adcDig32k(11666.8)  , // 21
-    adcDig32k(12133.2)  , // 20
-    adcDig32k(12621.6)  , // 19
-    adcDig32k(13133.2)  , // 18
-    adcDig32k(13669.4)  , // 17
-    adcDig32k(14231.3)  , // 16
-    adcDig32k(14820.5)  , // 15
-    adcDig32k(15438.5)  , // 14
-    adcDig32k(16086.8)  , // 13
-    adcDig32k(16767.1)  , // 12
-    adcDig32k(17481.4)  , // 11
-    adcDig32k(18231.4)  , // 10
-    adcDig32k(19019.3)  , // 9
-    adcDig32k(19847.2)  , // 8
-    adcDig32k(20717.4)  , // 7
-    adcDig32k(21632.5)  , // 6
-    adcDig32k(22594.9)  , // 5
-    adcDig32k(23607.7)  , // 4
-    adcDig32k(24673.6)  , // 3
-    adcDig32k(25796)    , // 2
-    adcDig32k(26978.1)  , // 1
-    adcDig32k(28223.7)  , // 0
-    adcDig32k(29536.6)  , // -1
-    adcDig32k(30921)    , // -2
-    adcDig32k(32381.2)  , // -3
-    adcDig32k(33922)    , // -4
-    adcDig32k(35548.4)  , // -5
-    adcDig32k(37265.9)  , // -6
-    adcDig32k(39080.2)  , // -7
-    adcDig32k(40997.5)  , // -8
-    adcDig32k(43024)    , // -9
-    adcDig32k(45168.3)  , // -10
-    adcDig32k(47436.5)  , // -11
-    adcDig32k(49837.3)  , // -12
-    adcDig32k(52379.4)  , // -13
-    adcDig32k(55072.4)  , // -14
-    adcDig32k(57926.4)  , // -15
-    adcDig32k(60952.1)  , // -16
-    adcDig32k(64161)    , // -17
-    adcDig32k(67567)    , // -18
-    adcDig32k(71182.2)  , // -19
-    adcDig32k(75021.7)  , // -20
-    adcDig32k(79101.3)  , // -21
-    adcDig32k(83437.9)  , // -22
-    adcDig32k(88049.8)  , // -23
-    adcDig32k(92956.8)  , // -24
-    adcDig32k(98180)    , // -25
-    adcDig32k(103743)   , // -26
-    adcDig32k(109669)   , // -27
-    adcDig32k(115988)   , // -28
-    adcDig32k(122726)   , // -29
-    adcDig32k(129917)   , // -30
-    adcDig32k(137593)   , // -31
-    adcDig32k(145792)   , // -32
-    adcDig32k(154554)   , // -33
-    adcDig32k(163923)   , // -34
-    adcDig32k(173946)   , // -35
-    adcDig32k(184674)   , // -36
-    adcDig32k(196163)   , // -37
-    adcDig32k(208474)   , // -38
-    adcDig32k(221672)   , // -39
-    adcDig32k(235830)   , // -40
-    adcDig32k(251027)   , // -41
-    adcDig32k(267347)   , // -42
-    adcDig32k(284884)   , // -43
-    adcDig32k(303740)   , // -44
-    adcDig32k(324026)   , // -45
-    adcDig32k(345863)   , // -46
-    adcDig32k(369386)   , // -47
-    adcDig32k(394738)   , // -48
-    adcDig32k(422081)   , // -49
-    adcDig32k(451590)   , // -50
-    adcDig32k(483454)   , // -51
-};
-#endif
-
-#ifdef B3435K
-// The raw ADC 32k lookup table for the NTC RT 10K B-constant = 3435K.
-const unsigned int rawAdc32k[] = {
-    adcDig32k(758.326)  , // 111
-    adcDig32k(776.23)   , // 110
-    adcDig32k(794.66)   , // 109
-    adcDig32k(813.62)   , // 108
-    adcDig32k(833.14)   , // 107
-    adcDig32k(853.23)   , // 106
-    adcDig32k(873.922)  , // 105
-    adcDig32k(895.23)   , // 104
-    adcDig32k(917.17)   , // 103
-    adcDig32k(939.766)  , // 102
-    adcDig32k(963.048)  , // 101
-    adcDig32k(987.037)  , // 100
-    adcDig32k(1011.76)  , // 99
-    adcDig32k(1037.23)  , // 98
-    adcDig32k(1063.5)   , // 97
-    adcDig32k(1090.57)  , // 96
-    adcDig32k(1118.49)  , // 95
-    adcDig32k(1147.27)  , // 94
-    adcDig32k(1176.97)  , // 93
-    adcDig32k(1207.6)   , // 92
-    adcDig32k(1239.2)   , // 91
-    adcDig32k(1271.81)  , // 90
-    adcDig32k(1305.46)  , // 89
-    adcDig32k(1340.2)   , // 88
-    adcDig32k(1376.07)  , // 87
-    adcDig32k(1413.1)   , // 86
-    adcDig32k(1451.35)  , // 85
-    adcDig32k(1490.85)  , // 84
-    adcDig32k(1531.66)  , // 83
-    adcDig32k(1573.82)  , // 82
-    adcDig32k(1617.4)   , // 81
-    adcDig32k(1662.44)  , // 80
-    adcDig32k(1708.99)  , // 79
-    adcDig32k(1757.13)  , // 78
-    adcDig32k(1806.91)  , // 77
-    adcDig32k(1858.4)   , // 76
-    adcDig32k(1911.67)  , // 75
-    adcDig32k(1966.78)  , // 74
-    adcDig32k(2023.81)  , // 73
-    adcDig32k(2082.84)  , // 72
-    adcDig32k(2143.95)  , // 71
-    adcDig32k(2207.23)  , // 70
-    adcDig32k(2272.76)  , // 69
-    adcDig32k(2340.64)  , // 68
-    adcDig32k(2410.96)  , // 67
-    adcDig32k(2483.83)  , // 66
-    adcDig32k(2559.35)  , // 65
-    adcDig32k(2637.63)  , // 64
-    adcDig32k(2718.8)   , // 63
-    adcDig32k(2802.97)  , // 62
-    adcDig32k(2890.28)  , // 61
-    adcDig32k(2980.85)  , // 60
-    adcDig32k(3074.84)  , // 59
-    adcDig32k(3172.38)  , // 58
-    adcDig32k(3273.63)  , // 57
-    adcDig32k(3378.76)  , // 56
-    adcDig32k(3487.94)  , // 55
-    adcDig32k(3601.35)  , // 54
-    adcDig32k(3719.18)  , // 53
-    adcDig32k(3841.62)  , // 52
-    adcDig32k(3968.88)  , // 51
-    adcDig32k(4101.19)  , // 50
-    adcDig32k(4238.77)  , // 49
-    adcDig32k(4381.87)  , // 48
-    adcDig32k(4530.74)  , // 47
-    adcDig32k(4685.64)  , // 46
-    adcDig32k(4846.87)  , // 45
-    adcDig32k(5014.71)  , // 44
-    adcDig32k(5189.5)   , // 43
-    adcDig32k(5371.52)  , // 42
-    adcDig32k(5561.15)  , // 41
-    adcDig32k(5758.76)  , // 40
-    adcDig32k(5964.73)  , // 39
-    adcDig32k(6179.46)  , // 38
-    adcDig32k(6403.37)  , // 37
-    adcDig32k(6636.93)  , // 36
-    adcDig32k(6880.6)   , // 35
-    adcDig32k(7134.91)  , // 34
-    adcDig32k(7400.4)   , // 33
-    adcDig32k(7677.5)   , // 32
-    adcDig32k(7967)     , // 31
-    adcDig32k(8269.41)  , // 30
-    adcDig32k(8585.41)  , // 29
-    adcDig32k(8915.71)  , // 28
-    adcDig32k(9261)     , // 27
-    adcDig32k(9622.2)   , // 26
-    adcDig32k(10000)    , // 25
-    adcDig32k(10395.3)  , // 24
-    adcDig32k(10809.1)  , // 23
-    adcDig32k(11242.4)  , // 22
-    adcDig32k(11696.1)  , // 21
-    adcDig32k(12171.4)  , // 20
-    adcDig32k(12669.5)  , // 19
-    adcDig32k(13191.6)  , // 18
-    adcDig32k(13739)    , // 17
-    adcDig32k(14313.3)  , // 16
-    adcDig32k(14915.7)  , // 15
-    adcDig32k(15547.9)  , // 14
-    adcDig32k(16211.7)  , // 13
-    adcDig32k(16908.7)  , // 12
-    adcDig32k(17641)    , // 11
-    adcDig32k(18410.4)  , // 10
-    adcDig32k(19219.3)  , // 9
-    adcDig32k(20069.8)  , // 8
-    adcDig32k(20964.4)  , // 7
-    adcDig32k(21905.8)  , // 6
-    adcDig32k(22896.6)  , // 5
-    adcDig32k(23940)    , // 4
-    adcDig32k(25038.9)  , // 3
-    adcDig32k(26196.8)  , // 2
-    adcDig32k(27417.3)  , // 1
-    adcDig32k(28704.3)  , // 0
-    adcDig32k(30061.8)  , // -1
-    adcDig32k(31494.2)  , // -2
-    adcDig32k(33006.2)  , // -3
-    adcDig32k(34602.9)  , // -4
-    adcDig32k(36289.7)  , // -5
-    adcDig32k(38072.2)  , // -6
-    adcDig32k(39956.6)  , // -7
-    adcDig32k(41949.6)  , // -8
-    adcDig32k(44058)    , // -9
-    adcDig32k(46290.2)  , // -10
-    adcDig32k(48653.5)  , // -11
-    adcDig32k(51157)    , // -12
-    adcDig32k(53810)    , // -13
-    adcDig32k(56622.7)  , // -14
-    adcDig32k(59606)    , // -15
-    adcDig32k(62771)    , // -16
-    adcDig32k(66132)    , // -17
-    adcDig32k(69700.5)  , // -18
-    adcDig32k(73492.2)  , // -19
-    adcDig32k(77522.5)  , // -20
-    adcDig32k(81808.6)  , // -21
-    adcDig32k(86368.6)  , // -22
-    adcDig32k(91222)    , // -23
-    adcDig32k(96391.1)  , // -24
-    adcDig32k(101898)   , // -25
-    adcDig32k(107768)   , // -26
-    adcDig32k(114028)   , // -27
-    adcDig32k(120707)   , // -28
-    adcDig32k(127837)   , // -29
-    adcDig32k(135452)   , // -30
-    adcDig32k(143590)   , // -31
-    adcDig32k(152290)   , // -32
-    adcDig32k(161596)   , // -33
-    adcDig32k(171556)   , // -34
-    adcDig32k(182221)   , // -35
-    adcDig32k(193648)   , // -36
-    adcDig32k(205898)   , // -37
-    adcDig32k(219036)   , // -38
-    adcDig32k(233136)   , // -39
-    adcDig32k(248276)   , // -40
-    adcDig32k(264544)   , // -41
-    adcDig32k(282031)   , // -42
-    adcDig32k(300842)   , // -43
-    adcDig32k(321090)   , // -44
-    adcDig32k(342894)   , // -45
-    adcDig32k(366392)   , // -46
-    adcDig32k(391730)   , // -47
-    adcDig32k(419068)   , // -48
-    adcDig32k(448585)   , // -49
-    adcDig32k(480475)   , // -50
-    adcDig32k(514947)   , // -51
-};
-#endif
-
-#ifdef B3950K
-// The raw ADC 32k lookup table for the NTC RT 10K B-constant = 3950K.
-const unsigned int rawAdc32k[] = {
-    adcDig32k(515.13)   , // 111
-    adcDig32k(529.14)   , // 110
-    adcDig32k(543.61)   , // 109
-    adcDig32k(558.55)   , // 108
-    adcDig32k(573.99)   , // 107
-    adcDig32k(589.94)   , // 106
-    adcDig32k(606.416)  , // 105
-    adcDig32k(623.45)   , // 104
-    adcDig32k(641.049)  , // 103
-    adcDig32k(659.246)  , // 102
-    adcDig32k(678.06)   , // 101
-    adcDig32k(697.52)   , // 100
-    adcDig32k(717.65)   , // 99
-    adcDig32k(738.464)  , // 98
-    adcDig32k(760.005)  , // 97
-    adcDig32k(782.296)  , // 96
-    adcDig32k(805.37)   , // 95
-    adcDig32k(829.249)  , // 94
-    adcDig32k(853.98)   , // 93
-    adcDig32k(879.58)   , // 92
-    adcDig32k(906.104)  , // 91
-    adcDig32k(933.577)  , // 90
-    adcDig32k(962.04)   , // 89
-    adcDig32k(991.54)   , // 88
-    adcDig32k(1022.11)  , // 87
-    adcDig32k(1053.81)  , // 86
-    adcDig32k(1086.67)  , // 85
-    adcDig32k(1120.75)  , // 84
-    adcDig32k(1156.1)   , // 83
-    adcDig32k(1192.77)  , // 82
-    adcDig32k(1230.83)  , // 81
-    adcDig32k(1270.32)  , // 80
-    adcDig32k(1311.32)  , // 79
-    adcDig32k(1353.88)  , // 78
-    adcDig32k(1398.08)  , // 77
-    adcDig32k(1443.99)  , // 76
-    adcDig32k(1491.68)  , // 75
-    adcDig32k(1541.24)  , // 74
-    adcDig32k(1592.74)  , // 73
-    adcDig32k(1646.28)  , // 72
-    adcDig32k(1701.95)  , // 71
-    adcDig32k(1759.84)  , // 70
-    adcDig32k(1820.05)  , // 69
-    adcDig32k(1882.7)   , // 68
-    adcDig32k(1947.89)  , // 67
-    adcDig32k(2015.74)  , // 66
-    adcDig32k(2086.37)  , // 65
-    adcDig32k(2159.93)  , // 64
-    adcDig32k(2236.53)  , // 63
-    adcDig32k(2316.34)  , // 62
-    adcDig32k(2399.5)   , // 61
-    adcDig32k(2486.16)  , // 60
-    adcDig32k(2576.51)  , // 59
-    adcDig32k(2670.72)  , // 58
-    adcDig32k(2768.98)  , // 57
-    adcDig32k(2871.48)  , // 56
-    adcDig32k(2978.44)  , // 55
-    adcDig32k(3090.07)  , // 54
-    adcDig32k(3206.6)   , // 53
-    adcDig32k(3328.29)  , // 52
-    adcDig32k(3455.39)  , // 51
-    adcDig32k(3588.18)  , // 50
-    adcDig32k(3726.95)  , // 49
-    adcDig32k(3872)     , // 48
-    adcDig32k(4023.64)  , // 47
-    adcDig32k(4182.23)  , // 46
-    adcDig32k(4348.14)  , // 45
-    adcDig32k(4521.73)  , // 44
-    adcDig32k(4703.4)   , // 43
-    adcDig32k(4893.63)  , // 42
-    adcDig32k(5092.8)   , // 41
-    adcDig32k(5301.5)   , // 40
-    adcDig32k(5520.08)  , // 39
-    adcDig32k(5749.21)  , // 38
-    adcDig32k(5989.41)  , // 37
-    adcDig32k(6241.3)   , // 36
-    adcDig32k(6505.53)  , // 35
-    adcDig32k(6782.77)  , // 34
-    adcDig32k(7073.8)   , // 33
-    adcDig32k(7379.26)  , // 32
-    adcDig32k(7700.1)   , // 31
-    adcDig32k(8037.14)  , // 30
-    adcDig32k(8391.31)  , // 29
-    adcDig32k(8763.61)  , // 28
-    adcDig32k(9155.1)   , // 27
-    adcDig32k(9566.8)   , // 26
-    adcDig32k(10000)    , // 25
-    adcDig32k(10455.9)  , // 24
-    adcDig32k(10936)    , // 23
-    adcDig32k(11441.5)  , // 22
-    adcDig32k(11974)    , // 21
-    adcDig32k(12535.3)  , // 20
-    adcDig32k(13127)    , // 19
-    adcDig32k(13751)    , // 18
-    adcDig32k(14409.2)  , // 17
-    adcDig32k(15103.9)  , // 16
-    adcDig32k(15837.2)  , // 15
-    adcDig32k(16611.5)  , // 14
-    adcDig32k(17429.6)  , // 13
-    adcDig32k(18294.1)  , // 12
-    adcDig32k(19208)    , // 11
-    adcDig32k(20174.6)  , // 10
-    adcDig32k(21197.1)  , // 9
-    adcDig32k(22279.3)  , // 8
-    adcDig32k(23425.1)  , // 7
-    adcDig32k(24638.7)  , // 6
-    adcDig32k(25924.6)  , // 5
-    adcDig32k(27287.5)  , // 4
-    adcDig32k(28732.8)  , // 3
-    adcDig32k(30266)    , // 2
-    adcDig32k(31893.1)  , // 1
-    adcDig32k(33620.6)  , // 0
-    adcDig32k(35455.4)  , // -1
-    adcDig32k(37405)    , // -2
-    adcDig32k(39477.3)  , // -3
-    adcDig32k(41681.3)  , // -4
-    adcDig32k(44026)    , // -5
-    adcDig32k(46521.8)  , // -6
-    adcDig32k(49179.4)  , // -7
-    adcDig32k(52010.6)  , // -8
-    adcDig32k(55028.2)  , // -9
-    adcDig32k(58245.7)  , // -10
-    adcDig32k(61678.1)  , // -11
-    adcDig32k(65341)    , // -12
-    adcDig32k(69253.1)  , // -13
-    adcDig32k(73431.9)  , // -14
-    adcDig32k(77898)    , // -15
-    adcDig32k(82674)    , // -16
-    adcDig32k(87783)    , // -17
-    adcDig32k(93252)    , // -18
-    adcDig32k(99109.3)  , // -19
-    adcDig32k(105384)   , // -20
-    adcDig32k(112112)   , // -21
-    adcDig32k(119327)   , // -22
-    adcDig32k(127071)   , // -23
-    adcDig32k(135385)   , // -24
-    adcDig32k(144317)   , // -25
-    adcDig32k(153918)   , // -26
-    adcDig32k(164242)   , // -27
-    adcDig32k(175353)   , // -28
-    adcDig32k(187317)   , // -29
-    adcDig32k(200204)   , // -30
-    adcDig32k(214096)   , // -31
-    adcDig32k(229079)   , // -32
-    adcDig32k(245249)   , // -33
-    adcDig32k(262710)   , // -34
-    adcDig32k(281577)   , // -35
-    adcDig32k(301975)   , // -36
-    adcDig32k(324044)   , // -37
-    adcDig32k(347933)   , // -38
-    adcDig32k(373811)   , // -39
-    adcDig32k(401860)   , // -40
-    adcDig32k(432284)   , // -41
-    adcDig32k(465304)   , // -42
-    adcDig32k(501167)   , // -43
-    adcDig32k(540146)   , // -44
-    adcDig32k(582536)   , // -45
-    adcDig32k(628672)   , // -46
-    adcDig32k(678921)   , // -47
-    adcDig32k(733685)   , // -48
-    adcDig32k(793417)   , // -49
-    adcDig32k(858615)   , // -50
-    adcDig32k(929829)   , // -51
-};
-#endif
-
-static unsigned int result;
-static unsigned long averaged;
-
-/**
- * @brief Initialize ADC's configuration registers.
- */
-void initADC()
-{
-    ADC_CR1 |= 0x70;    // Prescaler f/18 (SPSEL)
-    ADC_CSR |= 0x06;    // select AIN6
-    ADC_CSR |= 0x20;    // Interrupt enable (EOCIE)
-    ADC_CR1 |= 0x01;    // Power up ADC
-    result = 0;
-    averaged = 0;
-}
-
-/**
- * @brief Sets bit in ADC control register to start data convertion.
- */
-void startADC()
-{
-    ADC_CR1 |= 0x01;
-}
-
-/**
- * @brief Gets raw result of last data conversion.
- * @return raw result.
- */
-unsigned int getAdcResult()
-{
-    return result;
-}
-
-/**
- * @brief Gets averaged over 2^ADC_AVERAGING_BITS times result of data
- *  convertion.
- * @return averaged result.
- */
-unsigned int getAdcAveraged()
-{
-    return (unsigned int) (averaged >> ADC_AVERAGING_BITS);
-}
-
-/**
- * @brief Calculation of real temperature using averaged result of
- *  AnalogToDigital conversion and the lookup table.
- * @return temperature in tenth of degrees of Celsius.
- */
-int getTemperature()
-{
-    unsigned char rightBound = ADC_RAW_32K_SIZE-1;
-    unsigned char leftBound = 0;
-
-    int correct = getParamById (PARAM_TEMPERATURE_CORRECTION) ;
-
-    unsigned int val32k = averaged << (5-ADC_AVERAGING_BITS) ;
-
-    if(val32k>=rawAdc32k[0]&&val32k<rawAdc32k[ADC_RAW_32K_SIZE-1]) {
-
-      // search through the rawAdc32k lookup table
-      while ( (rightBound - leftBound) > 1) {
-          unsigned char midId = (leftBound + rightBound) >> 1;
-
-          if (val32k < rawAdc32k[midId]) {
-              rightBound = midId;
-          } else {
-              leftBound = midId;
-          }
-      }
-
-      // calculate the interpolated temperature value and return it
-      {
-        int i = (int) leftBound ;
-        if(val32k>=rawAdc32k[i]&&val32k<rawAdc32k[i+1]) {
-          unsigned int denom = (rawAdc32k[i+1]-rawAdc32k[i]) ;
-          unsigned int delta = (rawAdc32k[i+1]-val32k) ;
-          while(delta>(unsigned int)(-1)/10U) denom>>=1, delta>>=1 ;
-          if(!denom) denom=1 ;
-          {
-            int base_temp = ADC_RAW_32K_BASE_TEMP - (i+1)*10U ;
-            unsigned int delta_temp = 10U * delta / denom ; // interpolation
-            return base_temp + (int)delta_temp + correct ;
-          }
-        }
-      }
-
-    }
-
-    // temperature overflow
-    return
-        ADC_RAW_32K_BASE_TEMP
-            - ( val32k < rawAdc32k[0] ? 0 : (ADC_RAW_32K_SIZE-1) * 10 ) ;
-}
-
-/**
- * @brief This function is ADC's interrupt request handler
- *  so keep it extremely small and fast.
- */
-void ADC1_EOC_handler() __interrupt (22)
-{
-    result = ADC_DRH << 2;
-    result |= ADC_DRL;
-    ADC_CSR &= ~0x80;   // reset EOC
-
-    if(waitAdc) {
-      waitAdc--;
-      return ;
-    }
-
-    // Averaging result
-    if (averaged == 0) {
-        averaged = result << ADC_AVERAGING_BITS;
-    } else {
-        averaged += result - (averaged >> ADC_AVERAGING_BITS);
-    }
-}
+/*
+ * This file is part of the W1209 firmware replacement project
+ * (https://github.com/mister-grumbler/w1209-firmware).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Control functions for analog-to-digital converter (ADC).
+ * The ADC1 interrupt (22) is used to get signal on end of convertion event.
+ * The port D6 (pin 3) is used as analog input (AIN6).
+ * The lookup table of NTC thermistor is selected by PARAM_NTC_PROFILE.
+ * Each start of conversion makes a burst of ADC_BUFFER_SIZE conversions
+ * in buffered continuous mode, so the interrupt comes once per burst.
+ * The bursts are taken on each timer tick (2 ms) over a whole number of
+ * mains periods and then averaged, so the mains hum is cancelled.
+ * The sampling cycles are started at the rate given by PARAM_ADC_RATE,
+ * the ADC is idle between them. When the period of rate is shorter than
+ * the mains periods, the cycle is shortened to the period.
+ * The running statistics of results (Welford's mean and variance, min and
+ * max) show the noise of installation, see snapAdcStats().
+ * The analog watchdog of ADC is used to switch the relay off on the second
+ * of adjacent bursts of a cycle with a conversion out of allowed range of
+ * temperature, so a single noisy conversion does not cost the minimum off
+ * time of relay. The open or shorted probe is detected on the very burst
+ * and latched as a fault.
+ * The converted temperature is corrected by the optional curve from EEPROM,
+ * see setAdcCurve(), then calibrated by gain and offset which are taken
+ * from two points of known temperature, see calibrateAdc().
+ * The temperature is calculated in hundredth of degree, so the control of
+ * relay is not limited by the resolution of display.
+ */
+
+#include "adc.h"
+#include "stm8s003/adc.h"
+#include "params.h"
+#include "relay.h"
+#include "timer.h"
+#define ADCTABLE_DATA
+#include "adctable.h"
+
+#define INTERRUPT_ENABLE    __asm rim __endasm;
+#define INTERRUPT_DISABLE   __asm sim __endasm;
+
+// Flags of ADC_CSR which are polled, read through volatile access so the
+// load is not hoisted out of the wait
+#define ADC_CSR_FLAGS       (* (volatile unsigned char*) &ADC_CSR)
+
+// Fractional bits of the averaged result
+#define ADC_AVERAGING_BITS      5
+// Gain of the averaging filter is 1/2^bits, bits are in range FAST..SLOW
+#define ADC_FILTER_SLOW_BITS    4
+#define ADC_FILTER_FAST_BITS    0
+
+// Size of the ADC data buffer (ADC_DBxR) in words
+#define ADC_BUFFER_SIZE         10
+// Number of conversions to be summed per burst (2^ADC_BURST_BITS)
+#define ADC_BURST_BITS          3
+#define ADC_BURST_SIZE          (1 << ADC_BURST_BITS)
+
+// Bursts per sampling cycle, one per 2 ms tick: 1 period of 50Hz
+// or 3 periods of 60Hz
+#define ADC_50HZ_BURSTS         10
+#define ADC_60HZ_BURSTS         25
+
+
+// Statistics are taken over the last 256 .. 512 results
+#define ADC_STATS_WINDOW        512
+// Fractional bits of the mean of statistics
+#define ADC_STATS_BITS          4
+
+// Consecutive bursts hit by the analog watchdog which cut the relay off
+#define ADC_WATCHDOG_BURSTS     2
+
+// Results of sampling cycles being passed through the median filter
+#define ADC_MEDIAN_SIZE         3
+
+// Minimal distance between the points of calibration, tenth of degrees
+#define ADC_CALIBRATION_SPAN    100
+// Limit of calibrated temperature in hundredth of degrees, so it is
+// rounded to tenth and corrected by the curve (+/-12.7 degrees) with
+// no overflow of int
+#define ADC_CENTI_LIMIT         30000
+
+// Fractional bits of slopes of the correction curve
+#define ADC_CURVE_SLOPE_BITS    8
+// The first step of search over the curve: power of 2 below ADC_CURVE_SIZE
+#define ADC_CURVE_SEARCH        8
+// Limit of temperatures of the curve in tenth of degree
+#define ADC_CURVE_LIMIT         2000
+
+// Compare-exchange step of sorting network
+#define ADC_SORT(A, B)  if (A > B) { unsigned int t = A; A = B; B = t; }
+
+// Temperature of the first knot in hundredth of degree
+#define ADC_RAW_32K_BASE_TEMP (ADC_RAW_32K_TOP * 100)
+// Result of ADC is scaled to 15 bits (32k) for the lookup
+#define ADC_RAW_32K_SHIFT     (15 - ADC_RESOLUTION_BITS)
+
+// Conversion engine is selected by tools/adctable.c
+#if !defined (ADC_POLYNOMIAL) && !defined (ADC_QUADRATIC)
+#define ADC_TABLE
+#endif
+
+static unsigned char waitAdc = 1 ;
+
+static unsigned int result;
+static volatile bool resultReady;
+static volatile unsigned long resultSum;
+static volatile unsigned char resultSize;
+static unsigned long cycleSum;
+static unsigned char cycleSize;
+static unsigned char cycleTicks;
+static unsigned char cycleBursts;
+static unsigned int periodTicks;
+static unsigned long averaged;
+static unsigned int median[ADC_MEDIAN_SIZE];
+static unsigned char medianId;
+static unsigned int rejected;
+static int measured;
+static int temperature;
+static int temperatureCenti;
+static bool watchdog;
+static bool watchdogHit;
+static bool burstHit;
+static unsigned char watchdogBursts;
+static volatile bool overLimit;
+static volatile unsigned char fault;
+static unsigned int statCount;
+static long statMean;
+static unsigned long statM2;
+static unsigned int statMin;
+static unsigned int statMax;
+static unsigned int stats[ADC_STAT_SIZE];
+static bool statReset;
+static unsigned char curveSize;
+static int curveTemp[ADC_CURVE_SIZE];
+static int curveCorrection[ADC_CURVE_SIZE];
+static int curveSlope[ADC_CURVE_SIZE - 1];
+
+static void takeBurst();
+static void filterResult (unsigned int val);
+static unsigned int averageCycle (unsigned long sum, unsigned char size);
+static void prefillADC();
+static void updateStats (unsigned int val);
+static unsigned int sqrtLong (unsigned long val);
+static int calcTemperature();
+static int centiToTenths (int temp);
+static int calibrate (int temp);
+static int uncalibrate (int temp);
+static int correctByCurve (int temp);
+static int uncorrectByCurve (int temp);
+static unsigned int rawFromTemperature (int temp);
+static unsigned char getProfile();
+#ifdef ADC_TABLE
+static unsigned int decodeKnot (unsigned char profile, unsigned char i,
+                                unsigned int* step);
+#else
+static int rawToTemperature (unsigned char profile, unsigned int val32k);
+#endif
+#ifdef ADC_POLYNOMIAL
+static long log2Q15 (unsigned int x);
+#endif
+
+/**
+ * @brief Initialize ADC's configuration registers.
+ */
+void initADC()
+{
+    ADC_CR1 |= 0x70;    // Prescaler f/18 (SPSEL)
+    ADC_CSR |= 0x06;    // select AIN6
+    ADC_CSR |= 0x20;    // Interrupt enable (EOCIE)
+    ADC_CR3 |= 0x80;    // Data buffer enable (DBUF)
+    ADC_CR1 |= 0x01;    // Power up ADC
+    ADC_AWCRH = 0x03;   // Analog watchdog on all words of data buffer
+    ADC_AWCRL = 0xFF;
+    result = 0;
+    resultReady = false;
+    resultSum = 0;
+    resultSize = 0;
+    cycleTicks = cycleBursts = 0;
+    periodTicks = 0;
+    averaged = 0;
+    medianId = 0;
+    rejected = 0;
+    overLimit = watchdogHit = burstHit = false;
+    watchdogBursts = 0;
+    fault = ADC_FAULT_NONE;
+    statReset = true;
+    measured = correctByCurve (calcTemperature() );
+    temperatureCenti = calibrate (measured);
+    temperature = centiToTenths (temperatureCenti);
+    setAdcWatchdog();
+    prefillADC();
+}
+
+/**
+ * @brief Takes the first sampling cycles right away by polling, so the
+ *  filter is seeded and the temperature is valid before the relay is
+ *  initialized instead of after the first period of PARAM_ADC_RATE.
+ *  It runs before initTimer() sets the clock to 16 MHz, so at 2 MHz the
+ *  two cycles take tens of milliseconds.
+ *  The bursts follow each other with no wait, so the seed is not synced
+ *  to mains. The first cycle is dropped by waitAdc as the ADC is just
+ *  powered up, its bursts neither latch a fault nor trip the watchdog.
+ *  Must be called while the interrupts are disabled.
+ */
+static void prefillADC()
+{
+    unsigned char i;
+
+    for (i = 0; i < 2; i++) {
+        startADC();
+
+        while (cycleBursts != 0) {
+            ADC_CR1 |= 0x03;    // CONT and ADON
+
+            while (! (ADC_CSR_FLAGS & 0x80) ) {
+                // wait for the end of burst (EOC)
+            }
+
+            takeBurst();
+        }
+
+        if (resultReady) {
+            resultReady = false;
+            result = averageCycle (resultSum, resultSize);
+            filterResult (result);
+        }
+    }
+
+    // The bursts of cycle are already taken, next one is started by period
+    cycleTicks = 0;
+}
+
+/**
+ * @brief Programs thresholds of analog watchdog to the raw values of
+ *  PARAM_MAX_TEMPERATURE and PARAM_MIN_TEMPERATURE. The watchdog is only
+ *  active while PARAM_OVERHEAT_INDICATION is enabled.
+ *  Must be called each time when one of these parameters, the
+ *  PARAM_TEMPERATURE_CORRECTION, PARAM_NTC_PROFILE or the parameters of
+ *  calibration are changed.
+ */
+void setAdcWatchdog()
+{
+    unsigned int high = 0x3FF;
+    unsigned int low = 0;
+
+    watchdog = getParamById (PARAM_OVERHEAT_INDICATION);
+
+    if (watchdog) {
+        int max = uncorrectByCurve (uncalibrate (getParamById (PARAM_MAX_TEMPERATURE) * 100) );
+        int min = uncorrectByCurve (uncalibrate (getParamById (PARAM_MIN_TEMPERATURE) * 100) );
+
+        // Higher temperature gives lower value of ADC
+        low = rawFromTemperature (max) >> ADC_RAW_32K_SHIFT;
+        high = rawFromTemperature (min) >> ADC_RAW_32K_SHIFT;
+        ADC_CSR |= 0x10;    // Analog watchdog interrupt enable (AWDIE)
+    } else {
+        ADC_CSR &= ~0x10;
+        overLimit = false;
+    }
+
+    ADC_HTRH = (unsigned char) (high >> 2);
+    ADC_HTRL = (unsigned char) (high & 0x03);
+    ADC_LTRH = (unsigned char) (low >> 2);
+    ADC_LTRL = (unsigned char) (low & 0x03);
+}
+
+/**
+ * @brief Loads the correction curve and precomputes its slopes. The curve
+ *  is disabled when its size is out of range 2 .. ADC_CURVE_SIZE, the
+ *  temperatures are not ascending, out of +/-ADC_CURVE_LIMIT or a slope
+ *  is too steep, so the erased EEPROM gives no correction.
+ *  The unused points are padded, so the search always takes the same steps.
+ *  The span of curve takes more than int, so its differences are in long.
+ *  Must be called before initADC().
+ * @param size - number of points.
+ * @param temp - measured temperatures of points in tenth of degrees.
+ * @param correction - corrections of points in tenth of degrees.
+ */
+void setAdcCurve (unsigned char size, const int* temp, const signed char* correction)
+{
+    unsigned char i;
+
+    curveSize = 0;
+
+    if (size < 2 || size > ADC_CURVE_SIZE) {
+        return;
+    }
+
+    for (i = 0; i < size; i++) {
+        if (temp[i] < -ADC_CURVE_LIMIT || temp[i] > ADC_CURVE_LIMIT) {
+            return;
+        }
+
+        curveTemp[i] = temp[i] * 10;
+        curveCorrection[i] = correction[i] * 10;
+
+        if (i > 0) {
+            long slope;
+
+            if (curveTemp[i] <= curveTemp[i - 1]) {
+                return;
+            }
+
+            slope = ( (long) (curveCorrection[i] - curveCorrection[i - 1]) << ADC_CURVE_SLOPE_BITS)
+                    / ( (long) curveTemp[i] - curveTemp[i - 1]);
+
+            if (slope < -0x7FFF || slope > 0x7FFF) {
+                return;
+            }
+
+            curveSlope[i - 1] = (int) slope;
+        }
+    }
+
+    for (; i < ADC_CURVE_SIZE; i++) {
+        curveTemp[i] = 0x7FFF;
+    }
+
+    curveSize = size;
+}
+
+/**
+ * @brief Checks whether analog watchdog have detected conversions out of
+ *  allowed temperature range in ADC_WATCHDOG_BURSTS consecutive bursts
+ *  during the last sampling cycle.
+ * @return true - temperature limit is exceeded.
+ */
+bool isAdcOverLimit()
+{
+    return overLimit;
+}
+
+/**
+ * @brief Gets the fault of NTC probe which is latched by ADC1_EOC_handler()
+ *  on the first burst of conversions out of range of the probe.
+ * @return ADC_FAULT_NONE, ADC_FAULT_OPEN or ADC_FAULT_SHORT.
+ */
+unsigned char getAdcFault()
+{
+    return fault;
+}
+
+/**
+ * @brief Clears the latched fault of NTC probe. The averaging is restarted,
+ *  so the temperature is not affected by results taken during the fault.
+ *  The fault is latched again by the next burst if the probe is still bad.
+ */
+void clearAdcFault()
+{
+    if (fault != ADC_FAULT_NONE) {
+        averaged = 0;
+        fault = ADC_FAULT_NONE;
+    }
+}
+
+/**
+ * @brief Starts a sampling cycle which lasts for a whole number of mains
+ *  periods given by PARAM_MAINS_FREQUENCY or for the period of
+ *  PARAM_ADC_RATE when it is shorter. The next cycle is started by
+ *  refreshADC() when the period is over.
+ */
+void startADC()
+{
+    unsigned int period = TIMER_TICKS_IN_SECOND / getParamById (PARAM_ADC_RATE);
+
+    cycleSize = getParamById (PARAM_MAINS_FREQUENCY) ? ADC_60HZ_BURSTS : ADC_50HZ_BURSTS;
+
+    if (period < cycleSize) {
+        cycleSize = (unsigned char) period;
+    }
+
+    periodTicks = period;
+    cycleTicks = cycleBursts = cycleSize;
+    cycleSum = 0;
+
+    // Only adjacent bursts of the cycle trip the watchdog
+    watchdogBursts = 0;
+    burstHit = false;
+}
+
+/**
+ * @brief This function is being called during timer's interrupt
+ *  request so keep it extremely small and fast.
+ *  Starts the sampling cycle each period of PARAM_ADC_RATE and sets bits
+ *  in ADC control register to start a burst of data convertions in
+ *  continuous mode while sampling cycle is not finished.
+ */
+void refreshADC()
+{
+    if (periodTicks == 0 || --periodTicks == 0) {
+        startADC();
+    }
+
+    if (cycleTicks == 0) {
+        return;
+    }
+
+    cycleTicks--;
+
+    if (watchdog) {
+        ADC_CSR |= 0x10;    // AWDIE, disabled by the first hit in burst
+    }
+
+    ADC_CR1 |= 0x03;    // CONT and ADON
+}
+
+/**
+ * @brief Gets raw result of last sampling cycle, that is the sum
+ *  of 2^ADC_BURST_BITS conversions averaged over bursts of the cycle.
+ * @return raw result.
+ */
+unsigned int getAdcResult()
+{
+    return result;
+}
+
+/**
+ * @brief Takes a snapshot of the running statistics of results, so they
+ *  are cheap to be read by getAdcStat(). The statistics are updated by
+ *  refreshTemperature() in the main loop, so the copy is consistent.
+ */
+void snapAdcStats()
+{
+    unsigned int count;
+    long mean;
+    unsigned long m2;
+
+    count = statCount;
+    mean = statMean;
+    m2 = statM2;
+    stats[ADC_STAT_MIN] = statMin;
+    stats[ADC_STAT_MAX] = statMax;
+    stats[ADC_STAT_REJECTED] = rejected;
+
+    stats[ADC_STAT_COUNT] = count;
+    stats[ADC_STAT_MEAN] = (unsigned int) ( (mean + (1 << (ADC_STATS_BITS - 1) ) ) >> ADC_STATS_BITS);
+    stats[ADC_STAT_DEVIATION] = 0;
+
+    if (count > 1) {
+        // Standard deviation in tenth of count
+        stats[ADC_STAT_DEVIATION] = (unsigned int) ( ( (unsigned long) sqrtLong (m2 / (count - 1) ) * 10
+                                    + (1 << (ADC_STATS_BITS - 1) ) ) >> ADC_STATS_BITS);
+    }
+
+    if (count == 0) {
+        stats[ADC_STAT_MIN] = 0;
+    }
+}
+
+/**
+ * @brief Gets the statistic of results (see getAdcResult()) from the last
+ *  snapshot taken by snapAdcStats().
+ * @param id
+ *  ADC_STAT_COUNT - number of results, the window is kept within
+ *   256 .. 512 results by halving weight of older ones;
+ *  ADC_STAT_MEAN - mean of results;
+ *  ADC_STAT_DEVIATION - standard deviation in tenth of count, it is to
+ *   be compared with PARAM_FILTER_THRESHOLD;
+ *  ADC_STAT_MIN, ADC_STAT_MAX - the least and the largest result since
+ *   reset of statistics;
+ *  ADC_STAT_REJECTED - number of results which are off the median of
+ *   the last ones above PARAM_FILTER_THRESHOLD since reset of statistics.
+ * @return value of statistic, 0 for unknown id.
+ */
+unsigned int getAdcStat (unsigned char id)
+{
+    if (id < ADC_STAT_SIZE) {
+        return stats[id];
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Resets the running statistics of results. The reset is done by
+ *  the next result, so it is safe to be called from any context.
+ */
+void resetAdcStats()
+{
+    statReset = true;
+}
+
+/**
+ * @brief Updates the running statistics by Welford's method. When the
+ *  window is full, the count and the sum of squares are halved, so the
+ *  older results lose weight and nothing overflows. The sum of squares
+ *  is saturated on steps of a few thousands of counts, which are faults
+ *  rather than noise.
+ * @param val - result of sampling cycle.
+ */
+static void updateStats (unsigned int val)
+{
+    long delta;
+    int d1, d2;
+    unsigned long square;
+
+    if (statReset) {
+        statReset = false;
+        statCount = 0;
+        statMean = 0;
+        statM2 = 0;
+        statMin = 0xFFFF;
+        statMax = 0;
+        rejected = 0;
+    }
+
+    if (val < statMin) {
+        statMin = val;
+    }
+
+    if (val > statMax) {
+        statMax = val;
+    }
+
+    if (statCount == ADC_STATS_WINDOW) {
+        statCount >>= 1;
+        statM2 >>= 1;
+    }
+
+    statCount++;
+    delta = ( (long) val << ADC_STATS_BITS) - statMean;
+    d1 = delta > 0x7FFF ? 0x7FFF : delta < -0x7FFF ? -0x7FFF : (int) delta;
+    statMean += delta / (long) statCount;
+    delta = ( (long) val << ADC_STATS_BITS) - statMean;
+    d2 = delta > 0x7FFF ? 0x7FFF : delta < -0x7FFF ? -0x7FFF : (int) delta;
+
+    // Both deltas have the same sign
+    square = (unsigned long) ( (long) d1 * d2);
+
+    if (statM2 > 0xFFFFFFFF - square) {
+        statM2 = 0xFFFFFFFF;
+    } else {
+        statM2 += square;
+    }
+}
+
+/**
+ * @brief Integer square root, bit by bit.
+ * @param val
+ * @return floor of square root of val.
+ */
+static unsigned int sqrtLong (unsigned long val)
+{
+    unsigned int root = 0;
+    unsigned int bit;
+
+    for (bit = 0x8000; bit != 0; bit >>= 1) {
+        unsigned int trial = root | bit;
+
+        if ( (unsigned long) trial * trial <= val) {
+            root = trial;
+        }
+    }
+
+    return root;
+}
+
+/**
+ * @brief Gets result of data convertion averaged by adaptive filter.
+ *  The filter smooths with gain of 1/2^ADC_FILTER_SLOW_BITS while the
+ *  difference of new result from averaged one is within threshold given
+ *  by PARAM_FILTER_THRESHOLD and speeds up when the difference is larger.
+ * @return averaged result.
+ */
+unsigned int getAdcAveraged()
+{
+    return (unsigned int) (averaged >> ADC_AVERAGING_BITS);
+}
+
+/**
+ * @brief Gets the temperature calculated on the last data conversion.
+ *  The value is cached by refreshTemperature() so this call is cheap.
+ * @return temperature in tenth of degrees of Celsius.
+ */
+int getTemperature()
+{
+    return temperature;
+}
+
+/**
+ * @brief Gets the temperature calculated on the last data conversion in
+ *  full resolution, it is cached as well as getTemperature().
+ * @return temperature in hundredth of degrees of Celsius.
+ */
+int getTemperatureCenti()
+{
+    return temperatureCenti;
+}
+
+/**
+ * @brief Gets the temperature calculated on the last data conversion
+ *  before it is calibrated, the correction curve is already applied.
+ *  It is used to take points of calibration.
+ * @return temperature in tenth of degrees of Celsius.
+ */
+int getMeasuredTemperature()
+{
+    return centiToTenths (measured);
+}
+
+/**
+ * @brief Calculates gain and offset of calibration which give the reference
+ *  temperatures for the measured ones and stores them to the parameters.
+ *  PARAM_TEMPERATURE_CORRECTION is kept and applied after the calibration.
+ * @param measured1
+ * @param reference1
+ *  measured and reference temperature of the first point.
+ * @param measured2
+ * @param reference2
+ *  measured and reference temperature of the second point.
+ * @return false - the points are too close or give gain or offset out of
+ *  range, the calibration is not changed.
+ */
+bool calibrateAdc (int measured1, int reference1, int measured2, int reference2)
+{
+    int span = measured2 - measured1;
+    long gain;
+    long offset;
+
+    if (span > -ADC_CALIBRATION_SPAN && span < ADC_CALIBRATION_SPAN) {
+        return false;
+    }
+
+    gain = ( (long) (reference2 - reference1) << ADC_GAIN_BITS) / span;
+
+    if (gain < ADC_GAIN_MIN || gain > ADC_GAIN_MAX) {
+        return false;
+    }
+
+    offset = reference1 - getParamById (PARAM_TEMPERATURE_CORRECTION)
+             - ( ( (long) measured1 * gain + (ADC_GAIN_ONE >> 1) ) >> ADC_GAIN_BITS);
+
+    if (offset < -ADC_OFFSET_LIMIT || offset > ADC_OFFSET_LIMIT) {
+        return false;
+    }
+
+    setParamById (PARAM_CALIBRATION_GAIN, (int) gain);
+    setParamById (PARAM_CALIBRATION_OFFSET, (int) offset);
+
+    return true;
+}
+
+/**
+ * @brief Applies the correction curve to the temperature given by the
+ *  conversion engine. The point is found by bisection of fixed number of
+ *  steps and the correction is interpolated by precomputed slope, so the
+ *  cost does not depend on the temperature nor on the size of curve.
+ * @param temp - temperature in hundredth of degrees of Celsius.
+ * @return corrected temperature in hundredth of degrees of Celsius.
+ */
+static int correctByCurve (int temp)
+{
+    unsigned char i = 0;
+    unsigned char step;
+
+    if (curveSize == 0) {
+        return temp;
+    }
+
+    for (step = ADC_CURVE_SEARCH; step != 0; step >>= 1) {
+        if (i + step < ADC_CURVE_SIZE && temp >= curveTemp[i + step]) {
+            i += step;
+        }
+    }
+
+    // The correction is kept beyond the ends of the curve
+    if (temp <= curveTemp[0]) {
+        return temp + curveCorrection[0];
+    }
+
+    if (i >= curveSize - 1) {
+        return temp + curveCorrection[curveSize - 1];
+    }
+
+    return temp + curveCorrection[i]
+           + (int) ( ( ( (long) temp - curveTemp[i]) * curveSlope[i]) >> ADC_CURVE_SLOPE_BITS);
+}
+
+/**
+ * @brief Reverse of correctByCurve() for the thresholds of analog watchdog.
+ *  The corrections change slowly with temperature, so two steps of
+ *  fixed-point iteration are enough.
+ * @param temp - corrected temperature in hundredth of degrees of Celsius.
+ * @return temperature of conversion engine in hundredth of degrees of Celsius.
+ */
+static int uncorrectByCurve (int temp)
+{
+    int guess = temp - (correctByCurve (temp) - temp);
+
+    return temp - (correctByCurve (guess) - guess);
+}
+
+/**
+ * @brief Applies calibration and PARAM_TEMPERATURE_CORRECTION to the
+ *  measured temperature. It is called once per data conversion, so the
+ *  change of these parameters takes effect on the next conversion.
+ *  The multiplication is skipped while the gain is 1.
+ *  The result is calculated in long and clamped to +/-ADC_CENTI_LIMIT.
+ * @param temp - measured temperature in hundredth of degrees of Celsius.
+ * @return calibrated temperature in hundredth of degrees of Celsius.
+ */
+static int calibrate (int temp)
+{
+    int gain = getParamById (PARAM_CALIBRATION_GAIN);
+    long calibrated = temp;
+
+    if (gain != ADC_GAIN_ONE) {
+        calibrated = ( (long) temp * gain + (ADC_GAIN_ONE >> 1) ) >> ADC_GAIN_BITS;
+    }
+
+    calibrated += (long) (getParamById (PARAM_CALIBRATION_OFFSET)
+                          + getParamById (PARAM_TEMPERATURE_CORRECTION) ) * 10;
+
+    // The gain of about 2 and offsets may take it out of range of int
+    if (calibrated > ADC_CENTI_LIMIT) {
+        return ADC_CENTI_LIMIT;
+    } else if (calibrated < -ADC_CENTI_LIMIT) {
+        return -ADC_CENTI_LIMIT;
+    }
+
+    return (int) calibrated;
+}
+
+/**
+ * @brief Reverse of calibrate() for the thresholds of analog watchdog.
+ *  The result is calculated in long and clamped to +/-ADC_CENTI_LIMIT.
+ * @param temp - calibrated temperature in hundredth of degrees of Celsius.
+ * @return measured temperature in hundredth of degrees of Celsius.
+ */
+static int uncalibrate (int temp)
+{
+    long measured = temp - (long) (getParamById (PARAM_CALIBRATION_OFFSET)
+                                   + getParamById (PARAM_TEMPERATURE_CORRECTION) ) * 10;
+
+    measured = (measured << ADC_GAIN_BITS) / getParamById (PARAM_CALIBRATION_GAIN);
+
+    // The gain of 1/2 and offsets may take it out of range of int
+    if (measured > ADC_CENTI_LIMIT) {
+        return ADC_CENTI_LIMIT;
+    } else if (measured < -ADC_CENTI_LIMIT) {
+        return -ADC_CENTI_LIMIT;
+    }
+
+    return (int) measured;
+}
+
+/**
+ * @brief Rounds the temperature to tenth of degree.
+ * @param temp - temperature in hundredth of degrees of Celsius.
+ * @return temperature in tenth of degrees of Celsius.
+ */
+static int centiToTenths (int temp)
+{
+    return (temp + (temp < 0 ? -5 : 5) ) / 10;
+}
+
+#ifndef ADC_TABLE
+/**
+ * @brief Calculation of real temperature using averaged result of
+ *  AnalogToDigital conversion and the engine selected at build time.
+ * @return measured temperature in hundredth of degrees of Celsius.
+ */
+static int calcTemperature()
+{
+    unsigned int val32k = averaged >> (ADC_AVERAGING_BITS+ADC_BURST_BITS-ADC_RAW_32K_SHIFT) ;
+
+    return rawToTemperature (getProfile(), val32k) ;
+}
+
+/**
+ * @brief Reverse calculation of raw ADC 32k value for given temperature.
+ *  The value is found by binary search over bits of ADC result which are
+ *  used by the analog watchdog, so no inverse of the engine is needed.
+ * @param temp - temperature in hundredth of degrees of Celsius.
+ * @return raw value in 32k scale.
+ */
+static unsigned int rawFromTemperature (int temp)
+{
+    unsigned char profile = getProfile();
+    unsigned int raw = 0;
+    unsigned int bit;
+
+    // Higher temperature gives lower value of ADC
+    for (bit = 1 << (ADC_RESOLUTION_BITS - 1); bit != 0; bit >>= 1) {
+        if (rawToTemperature (profile, (raw | bit) << ADC_RAW_32K_SHIFT) >= temp) {
+            raw |= bit;
+        }
+    }
+
+    return raw << ADC_RAW_32K_SHIFT;
+}
+#else
+/**
+ * @brief Calculation of real temperature using averaged result of
+ *  AnalogToDigital conversion and the lookup table.
+ * @return measured temperature in hundredth of degrees of Celsius.
+ */
+static int calcTemperature()
+{
+    unsigned char leftBound;
+    unsigned char profile = getProfile();
+    unsigned int knot;
+    unsigned int step;
+
+    unsigned int val32k = averaged >> (ADC_AVERAGING_BITS+ADC_BURST_BITS-ADC_RAW_32K_SHIFT) ;
+
+    if(val32k>=rawAdc32kBase[profile][0]&&val32k<rawAdc32kBase[profile][ADC_BLOCKS]) {
+
+      // the coarse index points to the segment or a few segments before it
+      leftBound = rawAdc32kIndex[profile][val32k >> ADC_INDEX_SHIFT];
+      knot = decodeKnot (profile, leftBound, &step);
+
+      while (val32k >= knot + step) {
+          knot += step;
+          leftBound++;
+          step += rawAdc32kDiff[profile][leftBound];
+      }
+
+      // calculate the interpolated temperature value and return it
+      {
+        int i = (int) leftBound ;
+        unsigned int delta = (knot+step-val32k) ;
+        {
+          int base_temp = ADC_RAW_32K_BASE_TEMP - (i+1)*100U ;
+          // interpolation by the precomputed reciprocal slope, the
+          // fraction is taken in 1/16 of tenth to keep it in 16 bits
+          unsigned int delta_temp = (delta * rawAdc32kSlope[profile][i]) >> (ADC_SLOPE_SHIFT - 4) ;
+          return base_temp + (int) ( (delta_temp * 10 + 8) >> 4) ;
+        }
+      }
+
+    }
+
+    // temperature overflow
+    return
+        ADC_RAW_32K_BASE_TEMP
+            - ( val32k < rawAdc32kBase[profile][0] ? 0 : (ADC_RAW_32K_SIZE-1) * 100 ) ;
+}
+
+/**
+ * @brief Reverse calculation of raw ADC 32k value for given temperature
+ *  using the lookup table.
+ * @param temp - temperature in hundredth of degrees of Celsius.
+ * @return raw value in 32k scale.
+ */
+static unsigned int rawFromTemperature (int temp)
+{
+    unsigned char i;
+    unsigned char frac;
+    unsigned char profile = getProfile();
+    unsigned int knot;
+    unsigned int step;
+
+    if (temp >= ADC_RAW_32K_BASE_TEMP) {
+        return rawAdc32kBase[profile][0];
+    }
+
+    if (temp <= ADC_RAW_32K_BASE_TEMP - (int) (ADC_RAW_32K_SIZE - 1) * 100) {
+        return rawAdc32kBase[profile][ADC_BLOCKS];
+    }
+
+    i = (unsigned char) ( (ADC_RAW_32K_BASE_TEMP - temp) / 100);
+    frac = (unsigned char) ( (ADC_RAW_32K_BASE_TEMP - temp) % 100);
+    knot = decodeKnot (profile, i, &step);
+
+    return knot + (unsigned int) ( (unsigned long) step * frac / 100);
+}
+
+#endif
+
+/**
+ * @brief Gets the NTC thermistor profile selected by PARAM_NTC_PROFILE.
+ * @return index of lookup table, 0 for unknown profile.
+ */
+static unsigned char getProfile()
+{
+    unsigned char profile = (unsigned char) getParamById (PARAM_NTC_PROFILE);
+
+    if (profile >= ADC_PROFILES) {
+        profile = 0;
+    }
+
+    return profile;
+}
+
+#ifdef ADC_POLYNOMIAL
+/**
+ * @brief Evaluates the polynomial of selected profile in log2 (RT / R2)
+ *  by Horner's rule. The value is clamped to the range of the fit.
+ * @param profile
+ * @param val32k
+ * @return temperature in hundredth of degrees of Celsius.
+ */
+static int rawToTemperature (unsigned char profile, unsigned int val32k)
+{
+    const long* poly = adcPoly[profile];
+    signed char k;
+    long x;
+    long acc;
+
+    if (val32k < adcPolyRange[profile][0]) {
+        val32k = adcPolyRange[profile][0];
+    } else if (val32k > adcPolyRange[profile][1]) {
+        val32k = adcPolyRange[profile][1];
+    }
+
+    // RT / R2 = val32k / (32768 - val32k), Q15 to Q12
+    x = (log2Q15 (val32k) - log2Q15 (32768 - val32k) ) >> 3;
+    acc = poly[ADC_POLY_DEGREE];
+
+    for (k = ADC_POLY_DEGREE - 1; k >= 0; k--) {
+        acc = poly[k] + ( (acc * x) >> (12 + ADC_POLY_SHIFT) );
+    }
+
+    return (int) ( (acc * 10 + (1 << (ADC_POLY_SHIFT - 1) ) ) >> ADC_POLY_SHIFT);
+}
+
+/**
+ * @brief Fixed-point log2 with linear interpolation of the mantissa.
+ * @param x
+ *  in range 1 .. 0xFFFF.
+ * @return log2 (x) in Q15.
+ */
+static long log2Q15 (unsigned int x)
+{
+    unsigned char n = 15;
+    unsigned char i;
+    unsigned int r;
+
+    while (! (x & 0x8000) ) {
+        x <<= 1;
+        n--;
+    }
+
+    i = (x >> (15 - ADC_LOG2_BITS) ) & ( (1 << ADC_LOG2_BITS) - 1);
+    r = x & ( (1 << (15 - ADC_LOG2_BITS) ) - 1);
+
+    return ( (long) n << 15) + adcLog2[i]
+           + ( ( (unsigned long) (adcLog2[i + 1] - adcLog2[i]) * r) >> (15 - ADC_LOG2_BITS) );
+}
+#elif defined (ADC_QUADRATIC)
+/**
+ * @brief Quadratic interpolation within the segment of sparse knots of
+ *  selected profile. The value is clamped to the range of the knots.
+ * @param profile
+ * @param val32k
+ * @return temperature in hundredth of degrees of Celsius.
+ */
+static int rawToTemperature (unsigned char profile, unsigned int val32k)
+{
+    const unsigned int* knot = rawAdc32kQuadKnot[profile];
+    unsigned char lo = 0;
+    unsigned char hi = ADC_QUAD_SIZE - 1;
+    unsigned int d;
+    long q;
+
+    if (val32k < knot[0]) {
+        val32k = knot[0];
+    } else if (val32k >= knot[ADC_QUAD_SIZE - 1]) {
+        return rawAdc32kQuadTemp[profile][ADC_QUAD_SIZE - 1] * 100;
+    }
+
+    // binary search of the segment, the padding knots are above val32k
+    while (hi - lo > 1) {
+        unsigned char mid = (lo + hi) >> 1;
+
+        if (val32k >= knot[mid]) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    d = val32k - knot[lo];
+    q = rawAdc32kQuadSlope[profile][lo]
+        + ( ( (long) d * rawAdc32kQuadCurve[profile][lo]) >> ADC_QUAD_CURVE_SHIFT);
+
+    return rawAdc32kQuadTemp[profile][lo] * 100 - (int) ( (d * q * 10 + 0x8000) >> 16);
+}
+#else
+/**
+ * @brief Decodes the knot of the lookup table from the nearest preceding
+ *  block start, so it takes no more than (1 << ADC_BLOCK_BITS) - 1 steps.
+ * @param profile
+ * @param i
+ *  index of the knot in range 0 .. ADC_RAW_32K_SIZE - 2.
+ * @param step
+ *  is set to the distance from the knot to the next one.
+ * @return value of the knot.
+ */
+static unsigned int decodeKnot (unsigned char profile, unsigned char i,
+                                unsigned int* step)
+{
+    unsigned char k = i & ~ ( (1 << ADC_BLOCK_BITS) - 1);
+    unsigned int knot = rawAdc32kBase[profile][i >> ADC_BLOCK_BITS];
+    unsigned int s = rawAdc32kStep[profile][i >> ADC_BLOCK_BITS];
+
+    while (k < i) {
+        knot += s;
+        k++;
+        s += rawAdc32kDiff[profile][k];
+    }
+
+    *step = s;
+
+    return knot;
+}
+
+#endif
+
+/**
+ * @brief This function is ADC's interrupt request handler
+ *  so keep it extremely small and fast.
+ */
+void ADC1_EOC_handler() __interrupt (22)
+{
+    takeBurst();
+}
+
+/**
+ * @brief Handles the end of burst of conversions and the analog watchdog.
+ *  It is called by ADC1_EOC_handler() and by prefillADC() at startup.
+ *  The result of the whole cycle is left to refreshTemperature().
+ */
+static void takeBurst()
+{
+    unsigned char i;
+    unsigned int burst;
+
+    // Analog watchdog: temperature is out of range in consecutive bursts,
+    // switch the relay off right now and don't wait for the averaged result.
+    // The bursts of the warm-up cycle dropped by waitAdc are not counted.
+    if (ADC_CSR_FLAGS & 0x40) {
+        burstHit = waitAdc == 0;
+
+        if (burstHit && watchdogBursts >= ADC_WATCHDOG_BURSTS - 1) {
+            setRelay (false);
+            overLimit = watchdogHit = true;
+        }
+
+        ADC_CSR &= ~0x50;   // reset AWD and disable AWDIE till next burst
+        ADC_AWSRH = 0;
+        ADC_AWSRL = 0;
+
+        if (! (ADC_CSR_FLAGS & 0x80) ) {
+            return;
+        }
+    }
+
+    ADC_CR1 &= ~0x02;   // stop continuous conversion (CONT)
+
+    // The first words of buffer are skipped: they are taken right after
+    // the start and may be overwritten by the conversion being stopped.
+    burst = 0;
+
+    for (i = (ADC_BUFFER_SIZE - ADC_BURST_SIZE) << 1; i < ADC_BUFFER_SIZE << 1; i += 2) {
+        unsigned int val = ADC_DBxR[i] << 2;
+        burst += val | ADC_DBxR[i + 1];
+    }
+
+    ADC_CSR &= ~0x80;   // reset EOC
+    ADC_CR3 &= ~0x40;   // reset OVR
+
+    if (!burstHit) {
+        watchdogBursts = 0;
+    } else if (watchdogBursts < ADC_WATCHDOG_BURSTS) {
+        watchdogBursts++;
+    }
+
+    burstHit = false;
+
+    // Open or shorted probe: latch the fault and switch the relay off right
+    // now, the filtered temperature would only be clamped seconds later.
+    // The limits are generated by tools/adctable.c for the tables and R2.
+    // The warm-up cycle is dropped by waitAdc, so it latches no fault.
+    if (waitAdc != 0) {
+        // ADC is just powered up
+    } else if (burst > ADC_FAULT_OPEN_RAW * ADC_BURST_SIZE) {
+        setRelay (false);
+        fault = ADC_FAULT_OPEN;
+    } else if (burst < ADC_FAULT_SHORT_RAW * ADC_BURST_SIZE) {
+        setRelay (false);
+        fault = ADC_FAULT_SHORT;
+    }
+
+    cycleSum += burst;
+
+    if (cycleBursts == 0 || --cycleBursts != 0) {
+        return;
+    }
+
+    // Averaging over the whole mains periods is left to the main loop
+    resultSum = cycleSum;
+    resultSize = cycleSize;
+
+    // The limit is kept while each cycle trips the watchdog
+    overLimit = watchdogHit;
+    watchdogHit = false;
+    resultReady = true;
+}
+
+/**
+ * @brief Filters the result of the last sampling cycle and calculates the
+ *  temperature. It is called from the main loop, so the filter and the
+ *  search and division of the conversion are kept out of interrupts.
+ */
+void refreshTemperature()
+{
+    unsigned long sum;
+    unsigned char size;
+
+    if (!resultReady) {
+        return;
+    }
+
+    INTERRUPT_DISABLE
+    sum = resultSum;
+    size = resultSize;
+    resultReady = false;
+    INTERRUPT_ENABLE
+
+    result = averageCycle (sum, size);
+    filterResult (result);
+}
+
+/**
+ * @brief Averages the sum of bursts over the sampling cycle.
+ * @param sum - sum of bursts taken in the cycle.
+ * @param size - number of bursts in the cycle.
+ * @return result of sampling cycle.
+ */
+static unsigned int averageCycle (unsigned long sum, unsigned char size)
+{
+    return (unsigned int) ( (sum + (size >> 1) ) / size);
+}
+
+/**
+ * @brief Puts the result of sampling cycle into the statistics and the
+ *  averaging filter and updates the cached temperature.
+ * @param val - result of sampling cycle.
+ */
+static void filterResult (unsigned int val)
+{
+    if(waitAdc) {
+      waitAdc--;
+      return ;
+    }
+
+    updateStats (val);
+
+    // Averaging result
+    if (averaged == 0) {
+        median[0] = median[1] = median[2] = val;
+        averaged = (unsigned long) val << ADC_AVERAGING_BITS;
+    } else {
+        unsigned int a, b, c;
+        unsigned long diff;
+        bool rising;
+        unsigned int error, threshold = getParamById (PARAM_FILTER_THRESHOLD);
+        unsigned char bits = ADC_FILTER_SLOW_BITS;
+
+        // Median of last 3 results rejects a single spike
+        median[medianId] = val;
+        medianId = medianId < ADC_MEDIAN_SIZE - 1 ? medianId + 1 : 0;
+        a = median[0];
+        b = median[1];
+        c = median[2];
+        ADC_SORT (a, b);
+        ADC_SORT (b, c);
+        ADC_SORT (a, b);
+
+        // Count as outlier when the result is off the median above threshold
+        if ( (val > b ? val - b : b - val) > threshold) {
+            rejected++;
+        }
+
+        diff = (unsigned long) b << ADC_AVERAGING_BITS;
+        rising = diff >= averaged;
+
+        diff = rising ? diff - averaged : averaged - diff;
+        error = (unsigned int) (diff >> ADC_AVERAGING_BITS);
+
+        // The gain is doubled each time the error doubles over threshold
+        while (bits > ADC_FILTER_FAST_BITS && error > threshold) {
+            threshold <<= 1;
+            bits--;
+        }
+
+        if (rising) {
+            averaged += diff >> bits;
+        } else {
+            averaged -= diff >> bits;
+        }
+    }
+
+    measured = correctByCurve (calcTemperature() );
+    temperatureCenti = calibrate (measured);
+    temperature = centiToTenths (temperatureCenti);
+}
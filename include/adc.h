@@ -18,11 +18,56 @@
 #ifndef ADC_H
 #define ADC_H
 
+#ifndef bool
+#define bool    _Bool
+#define true    1
+#define false   0
+#endif
+
+#include "eeprom.h"
+
+/* Calibration gain is a fixed-point value with ADC_GAIN_BITS fraction bits */
+#define ADC_GAIN_BITS       14
+#define ADC_GAIN_ONE        (1 << ADC_GAIN_BITS)
+#define ADC_GAIN_MIN        (ADC_GAIN_ONE >> 1)
+#define ADC_GAIN_MAX        0x7FFF
+/* Limit of calibration offset in tenth of degrees */
+#define ADC_OFFSET_LIMIT    1000
+/* Maximal number of points of correction curve, see eeprom.h */
+#define ADC_CURVE_SIZE      EEPROM_CURVE_SIZE
+
+/* Statistics of ADC results, see getAdcStat() */
+#define ADC_STAT_COUNT      0
+#define ADC_STAT_MEAN       1
+#define ADC_STAT_DEVIATION  2
+#define ADC_STAT_MIN        3
+#define ADC_STAT_MAX        4
+#define ADC_STAT_REJECTED   5
+#define ADC_STAT_SIZE       6
+
+/* Faults of NTC probe */
+#define ADC_FAULT_NONE      0
+#define ADC_FAULT_OPEN      1
+#define ADC_FAULT_SHORT     2
+
 void initADC();
 void startADC();
+void refreshADC();
+void refreshTemperature();
+void setAdcWatchdog();
+void setAdcCurve (unsigned char size, const int* temp, const signed char* correction);
+bool isAdcOverLimit();
+unsigned char getAdcFault();
+void clearAdcFault();
 int getTemperature();
+int getTemperatureCenti();
+int getMeasuredTemperature();
+bool calibrateAdc (int measured1, int reference1, int measured2, int reference2);
 unsigned int getAdcResult();
 unsigned int getAdcAveraged();
+void snapAdcStats();
+unsigned int getAdcStat (unsigned char id);
+void resetAdcStats();
 void ADC1_EOC_handler() __interrupt (22);
 
 #endif
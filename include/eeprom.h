@@ -0,0 +1,39 @@
+/*
+ * This file is part of the W1209 firmware replacement project
+ * (https://github.com/mister-grumbler/w1209-firmware).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Layout of the data EEPROM, it is shared by params.c and the host-side
+ * generator of the correction curve image (tools/adccurve.c).
+ */
+
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#define EEPROM_BASE_ADDR        0x4000
+#define EEPROM_PARAMS_OFFSET    100
+// The block at EEPROM_PARAMS_OFFSET fits the first parameters only, the
+// next ones are stored from the beginning of EEPROM
+#define EEPROM_PARAMS_BLOCK     14
+#define EEPROM_PARAMS_EXT_OFFSET 0
+// Maximal number of points of correction curve
+#define EEPROM_CURVE_SIZE       12
+// Correction curve right below the parameters: the number of points, then
+// EEPROM_CURVE_SIZE of int temperatures and of signed char corrections
+#define EEPROM_CURVE_BYTES      (1 + EEPROM_CURVE_SIZE * 3)
+#define EEPROM_CURVE_OFFSET     (EEPROM_PARAMS_OFFSET - EEPROM_CURVE_BYTES)
+
+#endif
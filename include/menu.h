@@ -25,6 +25,10 @@
 #define MENU_CHANGE_PARAM    3
 #define MENU_RELAY_FORCE_ON  4
 #define MENU_RELAY_FORCE_OFF 5
+#define MENU_CALIBRATE_POINT1 6
+#define MENU_CALIBRATE_POINT2 7
+#define MENU_ADC_STATS       8
+#define MENU_AUTOTUNE        9
 /* Menu events */
 #define MENU_EVENT_PUSH_BUTTON1     0
 #define MENU_EVENT_PUSH_BUTTON2     1
@@ -38,6 +42,8 @@ void initMenu();
 void resetMenuTimer();
 void refreshMenu();
 unsigned char getMenuDisplay();
+int getMenuCalibration();
+unsigned char getMenuStat();
 void clickMenu(unsigned char event);
 void transitMenu();
 void feedMenu (unsigned char event);
@@ -26,7 +26,25 @@
 #define PARAM_TEMPERATURE_CORRECTION    4
 #define PARAM_RELAY_DELAY               5
 #define PARAM_OVERHEAT_INDICATION       6
+#define PARAM_FILTER_THRESHOLD          7
+#define PARAM_MAINS_FREQUENCY           8
 #define PARAM_THRESHOLD                 9
+#define PARAM_NTC_PROFILE               10
+#define PARAM_ADC_RATE                  11
+#define PARAM_CALIBRATION_GAIN          12
+#define PARAM_CALIBRATION_OFFSET        13
+#define PARAM_PID_CYCLE                 14
+#define PARAM_PID_KP                    15
+#define PARAM_PID_KI                    16
+#define PARAM_PID_KD                    17
+#define PARAM_RELAY_MIN_ON              18
+#define PARAM_RELAY_MIN_OFF             19
+#define PARAM_RELAY_LOCKOUT             20
+#define PARAM_OVERSHOOT_COMPENSATION    21
+#define PARAM_OVERSHOOT_ON              22
+#define PARAM_OVERSHOOT_OFF             23
+
+#define PARAM_COUNT                     24
 
 int getParam();
 void incParam();
@@ -34,6 +52,7 @@ void decParam();
 void incParamId();
 void decParamId();
 void storeParams();
+void storeParamById (unsigned char);
 void initParamsEEPROM();
 unsigned char getParamId();
 int getParamById (unsigned char);
@@ -28,9 +28,24 @@
 #define RELAY_FORCE_ON  1
 #define RELAY_FORCE_OFF 2
 
+/* Bits of PARAM_RELAY_MODE */
+#define RELAY_MODE_HEAT 0x01
+#define RELAY_MODE_PID  0x02
+
+/* States of autotune */
+#define RELAY_TUNE_OFF      0
+#define RELAY_TUNE_RUN      1
+#define RELAY_TUNE_DONE     2
+#define RELAY_TUNE_FAILED   3
+
 void initRelay();
 void refreshRelay();
 void setRelay (bool on);
 void setRelayForce (unsigned char rf);
+void startRelayTune();
+void stopRelayTune();
+unsigned char getRelayTune();
+unsigned char getRelayTuneCycle();
+void storeRelayLearned();
 
 #endif
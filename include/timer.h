@@ -18,14 +18,21 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+/* Timer ticks (2 ms) per second of uptime */
+#define TIMER_TICKS_IN_SECOND   500
+/* Calls of refreshRelay() per second of uptime, see TIM4_UPD_handler() */
+#define TIMER_RELAY_IN_SECOND   2
+
 void initTimer();
 void resetUptime();
 unsigned long getUptime();
 unsigned int getUptimeTicks();
 unsigned char getUptimeSeconds();
+unsigned long getUptimeInSeconds();
 unsigned char getUptimeMinutes();
 unsigned char getUptimeHours();
 unsigned char getUptimeDays();
+void runTimerTasks();
 void TIM4_UPD_handler() __interrupt (23);
 
 #endif
@@ -20,6 +20,7 @@
  */
 
 #include "menu.h"
+#include "adc.h"
 #include "buttons.h"
 #include "display.h"
 #include "params.h"
@@ -32,12 +33,18 @@
 #define MENU_AUTOINC_DELAY  MENU_1_SEC_PASSED / 8
 #define MENU_AUTOINC_FAST_DELAY  MENU_1_SEC_PASSED / 32
 #define MENU_FAST_WAIT      30
+#define MENU_CALIBRATION_TIMEOUT MENU_1_SEC_PASSED * 600
+#define MENU_STATS_TIMEOUT  MENU_1_SEC_PASSED * 300
 
 static unsigned char menuDisplay;
 static unsigned char menuState;
 static unsigned char fast_wait;
 static unsigned int timer;
 static bool hold,hold2,timer_reset;
+static int calReference;
+static int calMeasured;
+static int calPoint;
+static unsigned char statId;
 
 #define DEBOUNCE_MAX 10
 static int btnDebounce[3] ;
@@ -71,6 +78,24 @@ unsigned char getMenuDisplay()
     return menuDisplay;
 }
 
+/**
+ * @brief Gets reference temperature of calibration point being set.
+ * @return temperature in tenth of degrees of Celsius.
+ */
+int getMenuCalibration()
+{
+    return calReference;
+}
+
+/**
+ * @brief Gets identifier of ADC statistic being shown.
+ * @return one of ADC_STAT_* identifiers.
+ */
+unsigned char getMenuStat()
+{
+    return statId;
+}
+
 /**
  * @brief Changing buttons' status
  * @param event is one of:
@@ -135,6 +160,10 @@ void transitMenu()
  *  MENU_SELECT_PARAM
  *  MENU_CHANGE_PARAM
  *  MENU_SET_THRESHOLD
+ *  MENU_CALIBRATE_POINT1
+ *  MENU_CALIBRATE_POINT2
+ *  MENU_ADC_STATS
+ *  MENU_AUTOTUNE
  *
  * @param event is one of:
  *  MENU_EVENT_PUSH_BUTTON1
@@ -152,6 +181,9 @@ void feedMenu(unsigned char event)
     if (menuState == MENU_ROOT) {
         switch (event) {
         case MENU_EVENT_PUSH_BUTTON1:
+            // Acknowledge of probe fault, it is latched again if still bad
+            clearAdcFault();
+
             if(!hold) {
               menuDisplay = MENU_SET_THRESHOLD;
               hold = true ;
@@ -181,7 +213,28 @@ void feedMenu(unsigned char event)
             break;
 
         case MENU_EVENT_CHECK_TIMER:
-            if (getButton1() ) {
+            if (getButton2() && getButton3() ) {
+                if (timer > MENU_3_SEC_PASSED) {
+                    timer = 0;
+                    hold = hold2 = false;
+                    calReference = getTemperature();
+                    menuState = menuDisplay = MENU_CALIBRATE_POINT1;
+                }
+            } else if (getButton1() && getButton2() ) {
+                if (timer > MENU_3_SEC_PASSED) {
+                    timer = 0;
+                    hold = hold2 = false;
+                    startRelayTune();
+                    menuState = menuDisplay = MENU_AUTOTUNE;
+                }
+            } else if (getButton1() && getButton3() ) {
+                if (timer > MENU_3_SEC_PASSED) {
+                    timer = 0;
+                    hold = hold2 = false;
+                    statId = ADC_STAT_DEVIATION;
+                    menuState = menuDisplay = MENU_ADC_STATS;
+                }
+            } else if (getButton1() ) {
                 if (timer > MENU_3_SEC_PASSED) {
                     setParamId (0);
                     timer = 0;
@@ -358,6 +411,162 @@ void feedMenu(unsigned char event)
             hold=false ;
             break;
         }
+    } else if ( menuState == MENU_CALIBRATE_POINT1 ||
+                menuState == MENU_CALIBRATE_POINT2 ) {
+        // The reference temperature of the point is set by +/- and
+        // taken together with the measured one when SET is released.
+        switch (event) {
+        case MENU_EVENT_PUSH_BUTTON1:
+            hold = true ;
+            break;
+
+        case MENU_EVENT_RELEASE_BUTTON1:
+            if (hold && menuState == MENU_CALIBRATE_POINT1) {
+                calMeasured = getMeasuredTemperature();
+                calPoint = calReference;
+                calReference = getTemperature();
+                menuState = menuDisplay = MENU_CALIBRATE_POINT2;
+            } else if (hold) {
+                if (calibrateAdc (calMeasured, calPoint,
+                                  getMeasuredTemperature(), calReference) ) {
+                    storeParams();
+                }
+
+                menuState = menuDisplay = MENU_ROOT;
+            }
+
+            hold = false ;
+            break;
+
+        case MENU_EVENT_PUSH_BUTTON2:
+            if(!hold2) {
+              if (calReference < 1100) calReference++;
+              hold2=true ;
+            }
+            break;
+
+        case MENU_EVENT_PUSH_BUTTON3:
+            if(!hold2) {
+              if (calReference > -500) calReference--;
+              hold2=true ;
+            }
+            break;
+
+        case MENU_EVENT_RELEASE_BUTTON2:
+        case MENU_EVENT_RELEASE_BUTTON3:
+            hold2=false ;
+            break;
+
+        case MENU_EVENT_CHECK_TIMER:
+            if (hold2&&timer > MENU_1_SEC_PASSED + MENU_AUTOINC_DELAY) {
+                if (getButton2() && calReference < 1100) {
+                    calReference++;
+                    timer = MENU_1_SEC_PASSED;
+                } else if (getButton3() && calReference > -500) {
+                    calReference--;
+                    timer = MENU_1_SEC_PASSED;
+                }
+            }
+
+            // Leave the calibration unchanged when it is abandoned
+            if (timer > MENU_CALIBRATION_TIMEOUT) {
+                timer = 0;
+                menuState = menuDisplay = MENU_ROOT;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    } else if (menuState == MENU_ADC_STATS) {
+        // +/- select the statistic, SET returns to the root menu and holding
+        // SET for 3 seconds resets the statistics.
+        switch (event) {
+        case MENU_EVENT_PUSH_BUTTON1:
+            hold = true ;
+            break;
+
+        case MENU_EVENT_RELEASE_BUTTON1:
+            if (hold) {
+                menuState = menuDisplay = MENU_ROOT;
+            }
+
+            hold = false ;
+            break;
+
+        case MENU_EVENT_PUSH_BUTTON2:
+            if(!hold2) {
+              statId = statId < ADC_STAT_SIZE - 1 ? statId + 1 : 0;
+              hold2=true ;
+            }
+            break;
+
+        case MENU_EVENT_PUSH_BUTTON3:
+            if(!hold2) {
+              statId = statId > 0 ? statId - 1 : ADC_STAT_SIZE - 1;
+              hold2=true ;
+            }
+            break;
+
+        case MENU_EVENT_RELEASE_BUTTON2:
+        case MENU_EVENT_RELEASE_BUTTON3:
+            hold2=false ;
+            break;
+
+        case MENU_EVENT_CHECK_TIMER:
+            if (hold && getButton1() && timer > MENU_3_SEC_PASSED) {
+                resetAdcStats();
+                hold = false ;
+            }
+
+            if (timer > MENU_STATS_TIMEOUT) {
+                timer = 0;
+                menuState = menuDisplay = MENU_ROOT;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    } else if (menuState == MENU_AUTOTUNE) {
+        // SET aborts the autotune or leaves its result, the gains are
+        // stored as soon as they are found.
+        switch (event) {
+        case MENU_EVENT_PUSH_BUTTON1:
+            hold = true ;
+            break;
+
+        case MENU_EVENT_RELEASE_BUTTON1:
+            if (hold) {
+                stopRelayTune();
+                menuState = menuDisplay = MENU_ROOT;
+            }
+
+            hold = false ;
+            break;
+
+        case MENU_EVENT_CHECK_TIMER:
+            // hold2 marks the result as stored, +/- are not used here
+            if (getRelayTune() == RELAY_TUNE_RUN) {
+                timer = 0;
+            } else if (getRelayTune() == RELAY_TUNE_DONE && !hold2) {
+                storeParams();
+                hold2 = true ;
+            }
+
+            if (timer > MENU_STATS_TIMEOUT) {
+                timer = 0;
+                stopRelayTune();
+                menuState = menuDisplay = MENU_ROOT;
+            }
+
+            break;
+
+        default:
+            break;
+        }
     } else if (menuState == MENU_SET_THRESHOLD) {
         switch (event) {
         case MENU_EVENT_PUSH_BUTTON1:
@@ -451,8 +660,8 @@ void feedMenu(unsigned char event)
 
 
 /**
- * @brief This function is being called during timer's interrupt
- *  request so keep it extremely small and fast.
+ * @brief This function is being called from the main loop each 16
+ *  ticks of timer, see runTimerTasks().
  *  During this call all time-related functionality of application
  *  menu is handled. For example: fast value change while holding
  *  a button, return to root menu when no action is received from
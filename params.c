@@ -21,52 +21,97 @@
  * The list of aplication parameters with default values:
  * Name |Def| Description
  * -----+---+---------------------------------------------
- * P0 - | C | Cooling/Heating
+ * P0 - | C | Cooling/Heating, PC/PH - the same by PID control
  *            (relay ON when temperature is over(C)/below(H) threshold value)
  * P1 - | 2 | 0.1 ... 15.0 - Hysteresis
  * P2 - |110| 110 ... -45 - Maximum allowed temperature value
  * P3 - |-50| -50 ... 105 Minimum allowed temperature value
  * P4 - | 0 | 7.0 ... -7.0 Correction of temperature value
- * P5 - | 0 | 0 ... 10 Relay switching delay in minutes
+ * P5 - | 0 | 0 ... 10 Relay switching delay in minutes, the least of P18, P19
  * P6 - |Off| On/Off Indication of overheating
+ * P7 - | 8 | 1 ... 250 Threshold of averaging filter in ADC counts
+ * P8 - | 50| 50/60 Mains frequency (Hz) for synchronous sampling
+ * P10 | 0 | 0 ... 2 NTC thermistor profile: B-constant 3380K, 3435K, 3950K
+ *            (profiles are listed by AdcProfiles of Makefile)
+ * P11 | 2 | 1 ... 250 Sampling rate of temperature in Hz, over 50 (60Hz: 20)
+ *            the mains hum is not cancelled
+ * P14 | 30| 10 ... 250 Cycle of time-proportioned relay for PID in seconds
+ * P15 |100| 1 ... 999 Proportional gain of PID, per mille of cycle per degree
+ * P16 | 20| 1 ... 999 Integral gain of PID, per mille per degree-minute
+ * P17 | 0 | 0 ... 999 Derivative gain of PID, per mille per degree/minute
+ *            (P15 ... P17 can be found by autotune, see relay.c; P15 and P16
+ *            start from 1, so the cells left 0 by older firmware load the
+ *            defaults)
+ * P18 | 0 | 0 ... 999 Minimum on time of relay in seconds
+ * P19 | 0 | 0 ... 999 Minimum off time of relay in seconds
+ * P20 | 0 | 0 ... 999 Restart lockout of relay after reset in seconds
+ * P21 |Off| On/Off Compensation of overshoot for hysteresis control
  * TH - | 28| Threshold value
+ * CG - |1.0| 0.5 ... 2.0 Gain of two-point calibration (Q14 fixed point)
+ * CO - | 0 | -100.0 ... 100.0 Offset of two-point calibration
+ *            (CG and CO are set by the calibration menu, P4 is applied after
+ *            them as a fine correction)
+ * O1 - | 0 | 0 ... 10000 Learned overshoot after switching on, 0.01 degree
+ * O2 - | 0 | 0 ... 10000 Learned overshoot after switching off, 0.01 degree
+ *            (O1 and O2 are learned with P21 On, see relay.c)
  */
 
 #include "params.h"
 #include "stm8s003/prom.h"
+#include "adc.h"
+#include "eeprom.h"
+#include "adctable.h"
 #include "buttons.h"
-
-/* Definitions for EEPROM */
-#define EEPROM_BASE_ADDR        0x4000
-#define EEPROM_PARAMS_OFFSET    100
+#include "relay.h"
 
 static unsigned char paramId;
-static int paramCache[10];
-const int paramMin[] = {0, 1, -45, -50, -70, 0, 0, 0, 0, -500};
-const int paramMax[] = {1, 150, 110, 105, 70, 10, 1, 0, 0, 1100};
-const int paramDefault[] = {0, 20, 110, -50, 0, 0, 0, 0, 0, 280};
+static int paramCache[PARAM_COUNT];
+
+static void paramChanged (unsigned char id);
+static int* paramAddress (unsigned char id);
+static bool isParamHidden (unsigned char id);
+const int paramMin[] = {0, 1, -45, -50, -70, 0, 0, 1, 0, -500, 0, 1,
+                        ADC_GAIN_MIN, -ADC_OFFSET_LIMIT, 10, 1, 1, 0, 0, 0, 0, 0, 0, 0
+                       };
+const int paramMax[] = {RELAY_MODE_HEAT | RELAY_MODE_PID, 150, 110, 105, 70, 10, 1, 250, 1, 1100,
+                        ADC_PROFILES - 1, 250, ADC_GAIN_MAX, ADC_OFFSET_LIMIT, 250, 999, 999, 999,
+                        999, 999, 999, 1, 10000, 10000
+                       };
+const int paramDefault[] = {0, 20, 110, -50, 0, 0, 0, 8, 0, 280, 0, 2, ADC_GAIN_ONE, 0,
+                            30, 100, 20, 0, 0, 0, 0, 0, 0, 0
+                           };
 
 /**
  * @brief Check values in the EEPROM to be correct then load them into
- * parameters' cache.
+ * parameters' cache. The correction curve is loaded into the ADC, it is
+ * checked there and kept on restore of defaults.
  */
 void initParamsEEPROM()
 {
     if (getButton2() && getButton3() ) {
         // Restore parameters to default values
-        for (paramId = 0; paramId < 10; paramId++) {
+        for (paramId = 0; paramId < PARAM_COUNT; paramId++) {
             paramCache[paramId] = paramDefault[paramId];
         }
 
         storeParams();
     } else {
-        // Load parameters from EEPROM
-        for (paramId = 0; paramId < 10; paramId++) {
-            paramCache[paramId] = * (int*) (EEPROM_BASE_ADDR + EEPROM_PARAMS_OFFSET
-                                            + (paramId * sizeof paramCache[0]) );
+        // Load parameters from EEPROM, use default for out of range value
+        for (paramId = 0; paramId < PARAM_COUNT; paramId++) {
+            paramCache[paramId] = * paramAddress (paramId);
+
+            if (paramCache[paramId] < paramMin[paramId]
+                    || paramCache[paramId] > paramMax[paramId]) {
+                paramCache[paramId] = paramDefault[paramId];
+            }
         }
     }
 
+    setAdcCurve (* (unsigned char*) (EEPROM_BASE_ADDR + EEPROM_CURVE_OFFSET),
+                 (int*) (EEPROM_BASE_ADDR + EEPROM_CURVE_OFFSET + 1),
+                 (signed char*) (EEPROM_BASE_ADDR + EEPROM_CURVE_OFFSET + 1
+                                 + ADC_CURVE_SIZE * sizeof (int) ) );
+
     paramId = 0;
 }
 
@@ -77,7 +122,7 @@ void initParamsEEPROM()
  */
 int getParamById (unsigned char id)
 {
-    if (id < 10) {
+    if (id < PARAM_COUNT) {
         return paramCache[id];
     }
 
@@ -91,8 +136,9 @@ int getParamById (unsigned char id)
  */
 void setParamById (unsigned char id, int val)
 {
-    if (id < 10) {
+    if (id < PARAM_COUNT) {
         paramCache[id] = val;
+        paramChanged (id);
     }
 }
 
@@ -112,6 +158,7 @@ int getParam()
 void setParam (int val)
 {
     paramCache[paramId] = val;
+    paramChanged (paramId);
 }
 
 /**
@@ -119,11 +166,14 @@ void setParam (int val)
  */
 void incParam()
 {
-    if (paramId == PARAM_RELAY_MODE || paramId == PARAM_OVERHEAT_INDICATION) {
+    if (paramId == PARAM_OVERHEAT_INDICATION || paramId == PARAM_MAINS_FREQUENCY
+            || paramId == PARAM_OVERSHOOT_COMPENSATION) {
         paramCache[paramId] = ~paramCache[paramId] & 0x0001;
     } else if (paramCache[paramId] < paramMax[paramId]) {
         paramCache[paramId]++;
     }
+
+    paramChanged (paramId);
 }
 
 /**
@@ -131,11 +181,30 @@ void incParam()
  */
 void decParam()
 {
-    if (paramId == PARAM_RELAY_MODE || paramId == PARAM_OVERHEAT_INDICATION) {
+    if (paramId == PARAM_OVERHEAT_INDICATION || paramId == PARAM_MAINS_FREQUENCY
+            || paramId == PARAM_OVERSHOOT_COMPENSATION) {
         paramCache[paramId] = ~paramCache[paramId] & 0x0001;
     } else if (paramCache[paramId] > paramMin[paramId]) {
         paramCache[paramId]--;
     }
+
+    paramChanged (paramId);
+}
+
+/**
+ * @brief Applies the new value of parameter to the hardware which
+ *  depends on it.
+ * @param id
+ *  The identifier of changed parameter.
+ */
+static void paramChanged (unsigned char id)
+{
+    if (id == PARAM_MAX_TEMPERATURE || id == PARAM_MIN_TEMPERATURE
+            || id == PARAM_TEMPERATURE_CORRECTION || id == PARAM_OVERHEAT_INDICATION
+            || id == PARAM_NTC_PROFILE || id == PARAM_CALIBRATION_GAIN
+            || id == PARAM_CALIBRATION_OFFSET) {
+        setAdcWatchdog();
+    }
 }
 
 /**
@@ -153,7 +222,7 @@ unsigned char getParamId()
  */
 void setParamId (unsigned char val)
 {
-    if (val < 10) {
+    if (val < PARAM_COUNT) {
         paramId = val;
     }
 }
@@ -163,11 +232,13 @@ void setParamId (unsigned char val)
  */
 void incParamId()
 {
-    if (paramId < 6) {
-        paramId++;
-    } else {
-        paramId = 0;
-    }
+    do {
+        if (paramId < PARAM_COUNT - 1) {
+            paramId++;
+        } else {
+            paramId = 0;
+        }
+    } while (isParamHidden (paramId) );
 }
 
 /**
@@ -175,11 +246,25 @@ void incParamId()
  */
 void decParamId()
 {
-    if (paramId > 0) {
-        paramId--;
-    } else {
-        paramId = 6;
-    }
+    do {
+        if (paramId > 0) {
+            paramId--;
+        } else {
+            paramId = PARAM_COUNT - 1;
+        }
+    } while (isParamHidden (paramId) );
+}
+
+/**
+ * @brief Checks whether the parameter is skipped by the list of menu.
+ * @param id
+ * @return true - the parameter has its own menu.
+ */
+static bool isParamHidden (unsigned char id)
+{
+    return id == PARAM_THRESHOLD || id == PARAM_CALIBRATION_GAIN
+           || id == PARAM_CALIBRATION_OFFSET || id == PARAM_OVERSHOOT_ON
+           || id == PARAM_OVERSHOOT_OFF;
 }
 
 /**
@@ -193,7 +278,11 @@ void paramToString (unsigned char id, unsigned char* strBuff)
 {
     switch (id) {
     case PARAM_RELAY_MODE:
-        if (paramCache[id]) {
+        if (paramCache[id] & RELAY_MODE_PID) {
+            *strBuff++ = 'P';
+        }
+
+        if (paramCache[id] & RELAY_MODE_HEAT) {
             ( (unsigned char*) strBuff) [0] = 'H';
         } else {
             ( (unsigned char*) strBuff) [0] = 'C';
@@ -223,6 +312,7 @@ void paramToString (unsigned char id, unsigned char* strBuff)
         break;
 
     case PARAM_OVERHEAT_INDICATION:
+    case PARAM_OVERSHOOT_COMPENSATION:
         ( (unsigned char*) strBuff) [0] = 'O';
 
         if (paramCache[id]) {
@@ -236,6 +326,35 @@ void paramToString (unsigned char id, unsigned char* strBuff)
         ( (unsigned char*) strBuff) [3] = 0;
         break;
 
+    case PARAM_FILTER_THRESHOLD:
+        itofpa (paramCache[id], strBuff, 6);
+        break;
+
+    case PARAM_MAINS_FREQUENCY:
+        itofpa (paramCache[id] ? 60 : 50, strBuff, 6);
+        break;
+
+    case PARAM_NTC_PROFILE:
+        itofpa (paramCache[id], strBuff, 6);
+        break;
+
+    case PARAM_ADC_RATE:
+        itofpa (paramCache[id], strBuff, 6);
+        break;
+
+    case PARAM_PID_CYCLE:
+    case PARAM_PID_KP:
+    case PARAM_PID_KI:
+    case PARAM_PID_KD:
+        itofpa (paramCache[id], strBuff, 6);
+        break;
+
+    case PARAM_RELAY_MIN_ON:
+    case PARAM_RELAY_MIN_OFF:
+    case PARAM_RELAY_LOCKOUT:
+        itofpa (paramCache[id], strBuff, 6);
+        break;
+
     case PARAM_THRESHOLD:
         itofpa (paramCache[id], strBuff, 0);
         break;
@@ -262,17 +381,55 @@ void storeParams()
     }
 
     //  Write to the EEPROM parameters which value is changed.
-    for (i = 0; i < 10; i++) {
-        if (paramCache[i] != (* (int*) (EEPROM_BASE_ADDR + EEPROM_PARAMS_OFFSET
-                                        + (i * sizeof paramCache[0]) ) ) ) {
-            * (int*) (EEPROM_BASE_ADDR + EEPROM_PARAMS_OFFSET
-                      + (i * sizeof paramCache[0]) ) = paramCache[i];
+    for (i = 0; i < PARAM_COUNT; i++) {
+        if (paramCache[i] != * paramAddress (i) ) {
+            * paramAddress (i) = paramCache[i];
         }
     }
 
     //  Now write protect the EEPROM.
     FLASH_IAPSR &= ~0x08;
 }
+
+/**
+ * @brief Stores the given parameter from paramCache into EEPROM if it is
+ *  changed. Other parameters are not written, e.g. one which is being
+ *  edited in the menu.
+ * @param id
+ */
+void storeParamById (unsigned char id)
+{
+    if (id >= PARAM_COUNT || paramCache[id] == * paramAddress (id) ) {
+        return;
+    }
+
+    //  Check if the EEPROM is write-protected.  If it is then unlock the EEPROM.
+    if ( (FLASH_IAPSR & 0x08) == 0) {
+        FLASH_DUKR = 0xAE;
+        FLASH_DUKR = 0x56;
+    }
+
+    * paramAddress (id) = paramCache[id];
+
+    //  Now write protect the EEPROM.
+    FLASH_IAPSR &= ~0x08;
+}
+
+/**
+ * @brief Gets the address of parameter in EEPROM.
+ * @param id
+ * @return pointer to the parameter in EEPROM.
+ */
+static int* paramAddress (unsigned char id)
+{
+    if (id < EEPROM_PARAMS_BLOCK) {
+        return (int*) (EEPROM_BASE_ADDR + EEPROM_PARAMS_OFFSET + id * sizeof paramCache[0]);
+    }
+
+    return (int*) (EEPROM_BASE_ADDR + EEPROM_PARAMS_EXT_OFFSET
+                   + (id - EEPROM_PARAMS_BLOCK) * sizeof paramCache[0]);
+}
+
 /**
  * @brief
  * @param val
@@ -17,33 +17,173 @@
 
 /**
  * Control functions for relay.
+ * The relay is switched by hysteresis or, in PID modes of PARAM_RELAY_MODE,
+ * by the output of PID controller which is the part of time the relay is
+ * on within the cycle of PARAM_PID_CYCLE seconds.
+ * The gains of PID can be found by autotune: the relay is switched around
+ * the threshold by the hysteresis and the period and amplitude of the
+ * oscillation give the ultimate gain and period of the process
+ * (relay-feedback method of Astrom and Hagglund).
+ * With compensation of overshoot the switching points of hysteresis are
+ * shifted by the excursions of temperature learned after switching, so
+ * the peaks land on the threshold and the threshold plus hysteresis.
+ * In all modes the relay is kept on and off for the minimum times and it is
+ * not switched on within the restart lockout after reset. The times are
+ * taken in seconds of uptime, so they don't depend on the rate of calls.
  */
 
 #include "relay.h"
 #include "stm8s003/gpio.h"
 #include "adc.h"
 #include "params.h"
+#include "timer.h"
+
+#define INTERRUPT_ENABLE    __asm rim __endasm;
+#define INTERRUPT_DISABLE   __asm sim __endasm;
 
 #define RELAY_PORT              PA_ODR
 #define RELAY_BIT               0x08
-#define RELAY_TIMER_MULTIPLIER  7
+#define RELAY_DELAY_SECONDS     60
+
+// refreshRelay() is called twice per second of uptime, see timer.c
+#define RELAY_CALLS_PER_SECOND  TIMER_RELAY_IN_SECOND
+// Calls of refreshRelay() per minute
+#define RELAY_CALLS_PER_MINUTE  (RELAY_CALLS_PER_SECOND * 60)
+// Output of PID in per mille of the cycle
+#define RELAY_PID_MAX           1000
+// Integral sum per mille of output: 100 hundredth of degree by
+// calls per minute
+#define RELAY_PID_I_SCALE       (100L * RELAY_CALLS_PER_MINUTE)
+// Fractional bits of the filtered rate of temperature
+#define RELAY_PID_RATE_BITS     4
+// Limit of the filtered rate, so the derivative term fits long
+#define RELAY_PID_RATE_MAX      32767
+// Cycles of autotune, the first one is skipped as transient
+#define RELAY_TUNE_CYCLES       4
+// Longest cycle of autotune in calls: 4 hours
+#define RELAY_TUNE_TIMEOUT      (4U * 60 * RELAY_CALLS_PER_MINUTE)
+// Ultimate gain by the peak-to-peak amplitude in hundredth of degree:
+// 4 * 500 per mille / pi, by 100 hundredth and 2 amplitudes
+#define RELAY_TUNE_GAIN         127324L
+// Learned excursion follows the measured one with gain of 1/4
+#define RELAY_LEARN_BITS        2
+// Learned excursions are stored into EEPROM once per hour if changed
+#define RELAY_LEARN_STORE_SECONDS 3600
 
-static unsigned int timer;
+static unsigned long holdUntil;
 static bool state;
 
 static unsigned char force ;
 
+static bool pidReset;
+static unsigned char pidMode;
+static long pidSum;
+static int pidTemp;
+static int pidRate;
+static unsigned int pidPos;
+
+static bool learnState;
+static bool learnValid;
+static int learnTemp;
+static int learnPeak;
+static int learnOn;
+static int learnOff;
+static unsigned long learnStoreAt;
+static bool learnStorePending;
+
+static bool tuneOn;
+static unsigned char tuneState;
+static unsigned char tuneCycle;
+static unsigned int tuneTimer;
+static int tuneMax;
+static int tuneMin;
+static long tunePeriod;
+static long tuneAmplitude;
+
+static void setState (bool on);
+static void switchState (bool on);
+static bool refreshPid (int temp, int hold);
+static bool refreshTune (int temp, int hold, int hyst);
+static void learnOvershoot (int temp);
+static int getLearnShift (int learned, int hyst);
+static void finishTune();
+
 /**
- * @brief Configure appropriate bits for GPIO port A, reset local timer
- *  and reset state.
+ * @brief Configure appropriate bits for GPIO port A and reset state. The
+ *  relay is held off for the restart lockout, so with no lockout the first
+ *  call of refreshRelay() switches it by the temperature taken at startup.
  */
 void initRelay()
 {
     PA_DDR |= RELAY_BIT;
     PA_CR1 |= RELAY_BIT;
-    timer = 0;
+    holdUntil = getUptimeInSeconds() + getParamById (PARAM_RELAY_LOCKOUT);
     state = false;
     force = RELAY_FORCE_NA;
+    pidReset = true;
+    pidMode = (unsigned char) getParamById (PARAM_RELAY_MODE);
+    tuneState = RELAY_TUNE_OFF;
+    learnValid = false;
+    learnOn = getParamById (PARAM_OVERSHOOT_ON);
+    learnOff = getParamById (PARAM_OVERSHOOT_OFF);
+    learnStoreAt = getUptimeInSeconds() + RELAY_LEARN_STORE_SECONDS;
+    learnStorePending = false;
+}
+
+/**
+ * @brief Starts autotune of PID gains. The relay is switched by the
+ *  threshold and hysteresis until RELAY_TUNE_CYCLES cycles are measured.
+ */
+void startRelayTune()
+{
+    tuneState = RELAY_TUNE_RUN;
+    tuneCycle = 0;
+    tuneTimer = 0;
+    tuneOn = state;
+}
+
+/**
+ * @brief Stops autotune or clears its result, the relay returns to the
+ *  mode of PARAM_RELAY_MODE.
+ */
+void stopRelayTune()
+{
+    tuneState = RELAY_TUNE_OFF;
+    pidReset = true;
+}
+
+/**
+ * @brief Gets state of autotune.
+ * @return one of RELAY_TUNE_* states.
+ */
+unsigned char getRelayTune()
+{
+    return tuneState;
+}
+
+/**
+ * @brief Gets progress of autotune.
+ * @return number of cycles of the relay started, up to RELAY_TUNE_CYCLES.
+ */
+unsigned char getRelayTuneCycle()
+{
+    return tuneCycle;
+}
+
+/**
+ * @brief Stores the learned excursions of overshoot into EEPROM when they
+ *  are updated by refreshRelay(). Only these parameters are written, so a
+ *  value being edited in the menu is not stored. Writing of EEPROM takes
+ *  a few ms, so it is to be called from the main loop, not from an
+ *  interrupt.
+ */
+void storeRelayLearned()
+{
+    if (learnStorePending) {
+        learnStorePending = false;
+        storeParamById (PARAM_OVERSHOOT_ON);
+        storeParamById (PARAM_OVERSHOOT_OFF);
+    }
 }
 
 /**
@@ -70,55 +210,365 @@ void setRelay (bool on)
 }
 
 /**
- * @brief This function is being called during timer's interrupt
- *  request so keep it extremely small and fast.
+ * @brief This function is being called from the main loop
+ *  RELAY_CALLS_PER_SECOND times per second of uptime, see runTimerTasks().
+ *  The temperature is compared in hundredth of degree, so the relay is
+ *  not switched by the rounding of the displayed value.
  */
 void refreshRelay()
 {
-    bool mode = getParamById (PARAM_RELAY_MODE);
+    unsigned char mode = (unsigned char) getParamById (PARAM_RELAY_MODE);
+
+    int temp = getTemperatureCenti() ;
+    int hold = getParamById (PARAM_THRESHOLD) *10 ;
+    int hyst = getParamById (PARAM_RELAY_HYSTERESIS) *10 ;
+    bool on ;
+
+    // The change of mode restarts PID, e.g. PC and PH take the temperature
+    // of opposite sign
+    if (mode != pidMode) {
+        pidMode = mode;
+        pidReset = true;
+    }
 
-    int temp = getTemperature() ;
-    int hold = getParamById (PARAM_THRESHOLD) ;
-    int hyst = getParamById (PARAM_RELAY_HYSTERESIS) ;
+    // faulty probe, the relay is kept off even if it is forced
+    if (getAdcFault() != ADC_FAULT_NONE) {
+        setState (false);
+        setRelay (false);
+        learnValid = false;
+        pidReset = true;
+
+        if (tuneState == RELAY_TUNE_RUN) {
+            tuneState = RELAY_TUNE_FAILED;
+        }
+
+        return;
+    }
 
     // overheat protection
     if (getParamById (PARAM_OVERHEAT_INDICATION) ) {
-        if ( temp < getParamById (PARAM_MIN_TEMPERATURE) *10 /*LLL*/ ||
-             temp > getParamById (PARAM_MAX_TEMPERATURE) *10 /*HHH*/ ) {
+        if ( isAdcOverLimit() ||
+             temp < getParamById (PARAM_MIN_TEMPERATURE) *100 /*LLL*/ ||
+             temp > getParamById (PARAM_MAX_TEMPERATURE) *100 /*HHH*/ ) {
+            setState (false);
             setRelay (false);
-            timer = 0 ;
+            learnValid = false;
+            pidReset = true;
+
+            if (tuneState == RELAY_TUNE_RUN) {
+                tuneState = RELAY_TUNE_FAILED;
+            }
+
             return; // overheat or too cold
         }
     }
 
-    if(mode) { // Hot
+    if(mode & RELAY_MODE_HEAT) { // Hot
       // inverse
       temp = - temp ;
       hold = - hold ;
     }
-    if(state) { // Relay state is enabled
-      if(temp <= hold) {
-          if ( (getParamById (PARAM_RELAY_DELAY) << RELAY_TIMER_MULTIPLIER) < timer) {
-              state = false; timer = 0 ;
-          }
+    if(tuneState == RELAY_TUNE_RUN) {
+      switchState (refreshTune (temp, hold, hyst)) ;
+    }else if(mode & RELAY_MODE_PID) {
+      switchState (refreshPid (temp, hold)) ;
+    }else if(state) { // Relay state is enabled
+      pidReset = true ;
+      if(temp <= hold + getLearnShift (learnOff, hyst)) {
+          switchState (false) ;
       }
     }else { // Relay state is disabled
-      if(temp >= hold+hyst) {
-          if ( (getParamById (PARAM_RELAY_DELAY) << RELAY_TIMER_MULTIPLIER) < timer) {
-              state = true; timer = 0 ;
-          }
+      pidReset = true ;
+      if(temp >= hold + hyst - getLearnShift (learnOn, hyst)) {
+          switchState (true) ;
       }
     }
+
+    if(tuneState != RELAY_TUNE_RUN && !(mode & RELAY_MODE_PID)
+            && getParamById (PARAM_OVERSHOOT_COMPENSATION) && force == RELAY_FORCE_NA) {
+      learnOvershoot (temp) ;
+    }else {
+      learnValid = false ;
+    }
+
     switch(force) {
     case RELAY_FORCE_ON:
-        setRelay(true);
+        on = true;
         break;
     case RELAY_FORCE_OFF:
-        setRelay(false);
+        on = false;
         break;
     case RELAY_FORCE_NA:
     default:
-        setRelay(state);
+        on = state;
+    }
+
+    // The ADC interrupt may cut the relay off after the checks above, so
+    // they are repeated with the interrupts disabled before switching.
+    // Must be called while the interrupts are enabled.
+    INTERRUPT_DISABLE
+    if(getAdcFault() != ADC_FAULT_NONE || isAdcOverLimit()) {
+      on = false ;
+    }
+    setRelay (on) ;
+    INTERRUPT_ENABLE
+}
+
+/**
+ * @brief Sets state of the relay and holds it for the minimum on or off
+ *  time. The relay delay of PARAM_RELAY_DELAY is the least of both times.
+ *  The hold which is already longer, e.g. the restart lockout, is kept.
+ * @param on - true, off - false
+ */
+static void setState (bool on)
+{
+    unsigned int delay = getParamById (PARAM_RELAY_DELAY) * RELAY_DELAY_SECONDS;
+    unsigned int hold = getParamById (on ? PARAM_RELAY_MIN_ON : PARAM_RELAY_MIN_OFF);
+    unsigned long until = getUptimeInSeconds() + (hold > delay ? hold : delay);
+
+    state = on;
+
+    // The deadline is only moved later, so the restart lockout is kept
+    if (until > holdUntil) {
+        holdUntil = until;
+    }
+}
+
+/**
+ * @brief Switches the relay when it is not held by the minimum time of
+ *  its state or by the restart lockout.
+ * @param on - true, off - false
+ */
+static void switchState (bool on)
+{
+    if (on != state && getUptimeInSeconds() >= holdUntil) {
+        setState (on);
+    }
+}
+
+/**
+ * @brief PID controller with time-proportioned output. The temperature is
+ *  given in terms of cooling, so the positive error needs the relay on.
+ *  The derivative is taken on the filtered rate of temperature instead of
+ *  the error, so the change of threshold makes no kick. The integral is
+ *  not accumulated while the output is saturated in the direction of
+ *  error and it is clamped to the range of output (anti-windup).
+ *  It takes two divisions and a few multiplications of long values, so
+ *  it fits the slot of refreshRelay().
+ * @param temp - temperature in hundredth of degree.
+ * @param hold - threshold in hundredth of degree.
+ * @return state of the relay for the current position of cycle.
+ */
+static bool refreshPid (int temp, int hold)
+{
+    int error = temp - hold;
+    unsigned int cycle = getParamById (PARAM_PID_CYCLE) * RELAY_CALLS_PER_SECOND;
+    long out;
+    long integral;
+    long rate;
+
+    if (pidReset) {
+        pidReset = false;
+        pidSum = 0;
+        pidTemp = temp;
+        pidRate = 0;
+        pidPos = 0;
     }
-    timer++;
+
+    // Rate in hundredth of degree per call, filtered with gain of 1/4
+    rate = pidRate + ( ( ( ( (long) temp - pidTemp) << RELAY_PID_RATE_BITS) - pidRate) >> 2);
+
+    if (rate > RELAY_PID_RATE_MAX) {
+        rate = RELAY_PID_RATE_MAX;
+    } else if (rate < -RELAY_PID_RATE_MAX) {
+        rate = -RELAY_PID_RATE_MAX;
+    }
+
+    pidRate = (int) rate;
+    pidTemp = temp;
+
+    // Degree per minute is the rate by calls per minute and 1/100 of
+    // degree, that is 3/5 of the rate by calls per second
+    out = (long) getParamById (PARAM_PID_KP) * error / 100
+          + ( (long) getParamById (PARAM_PID_KD) * pidRate * (RELAY_CALLS_PER_SECOND * 3) / 5
+              >> RELAY_PID_RATE_BITS);
+    integral = pidSum / RELAY_PID_I_SCALE;
+
+    if ( (error > 0 && out + integral < RELAY_PID_MAX)
+            || (error < 0 && out + integral > 0) ) {
+        pidSum += (long) getParamById (PARAM_PID_KI) * error;
+
+        if (pidSum < 0) {
+            pidSum = 0;
+        } else if (pidSum > RELAY_PID_MAX * RELAY_PID_I_SCALE) {
+            pidSum = RELAY_PID_MAX * RELAY_PID_I_SCALE;
+        }
+
+        integral = pidSum / RELAY_PID_I_SCALE;
+    }
+
+    out += integral;
+
+    if (out < 0) {
+        out = 0;
+    } else if (out > RELAY_PID_MAX) {
+        out = RELAY_PID_MAX;
+    }
+
+    if (++pidPos >= cycle) {
+        pidPos = 0;
+    }
+
+    return (long) pidPos * RELAY_PID_MAX < out * cycle;
+}
+
+/**
+ * @brief Switches the relay around the threshold for autotune and measures
+ *  the cycles between switching on. The temperature is given in terms of
+ *  cooling, so the relay is on over the band of hysteresis centered on the
+ *  threshold and off below it. The relay may be held by the minimum times,
+ *  so the cycles are counted by its actual state.
+ * @param temp - temperature in hundredth of degree.
+ * @param hold - threshold in hundredth of degree.
+ * @param hyst - hysteresis in hundredth of degree.
+ * @return requested state of the relay.
+ */
+static bool refreshTune (int temp, int hold, int hyst)
+{
+    if (tuneMax < temp) {
+        tuneMax = temp;
+    }
+
+    if (tuneMin > temp) {
+        tuneMin = temp;
+    }
+
+    if (++tuneTimer > RELAY_TUNE_TIMEOUT) {
+        tuneState = RELAY_TUNE_FAILED;
+        return false;
+    }
+
+    if (state && !tuneOn) {
+        // Cycle is over when the relay is switched on again
+        if (tuneCycle > 1) {
+            tunePeriod += tuneTimer;
+            tuneAmplitude += tuneMax - tuneMin;
+        } else {
+            tunePeriod = 0;
+            tuneAmplitude = 0;
+        }
+
+        if (tuneCycle == RELAY_TUNE_CYCLES) {
+            finishTune();
+            return false;
+        }
+
+        tuneCycle++;
+        tuneTimer = 0;
+        tuneMax = tuneMin = temp;
+    }
+
+    tuneOn = state;
+
+    if (state) {
+        return temp > hold - (hyst >> 1);
+    }
+
+    return temp >= hold + hyst - (hyst >> 1);
+}
+
+/**
+ * @brief Calculates PID gains by the ultimate gain Ku and period Tu of the
+ *  measured cycles with the rule of Ziegler and Nichols for PID:
+ *  Kp = 0.6 * Ku, Ti = Tu / 2, Td = Tu / 8. The gains are set in units of
+ *  PARAM_PID_KP, PARAM_PID_KI, PARAM_PID_KD and the mode is switched to PID.
+ *  The parameters are to be stored by the caller.
+ */
+static void finishTune()
+{
+    long n = RELAY_TUNE_CYCLES - 1;
+    long kp, ki, kd;
+
+    if (tuneAmplitude <= 0 || tunePeriod <= 0) {
+        tuneState = RELAY_TUNE_FAILED;
+        return;
+    }
+
+    // Ku in per mille per degree by the mean amplitude, Tu in calls
+    kp = RELAY_TUNE_GAIN * n * 3 / 5 / tuneAmplitude;
+
+    // Kp and Ki of 0 are out of range, see PARAM_PID_KP
+    if (kp > 999) {
+        kp = 999;
+    } else if (kp < 1) {
+        kp = 1;
+    }
+
+    // Ki = Kp / Ti per minute, Kd = Kp * Td in minutes
+    ki = kp * RELAY_CALLS_PER_MINUTE * 2 * n / tunePeriod;
+    kd = kp * tunePeriod / (8L * RELAY_CALLS_PER_MINUTE * n);
+
+    setParamById (PARAM_PID_KP, (int) kp);
+    setParamById (PARAM_PID_KI, ki > 999 ? 999 : ki < 1 ? 1 : (int) ki);
+    setParamById (PARAM_PID_KD, kd > 999 ? 999 : (int) kd);
+    setParamById (PARAM_RELAY_MODE, getParamById (PARAM_RELAY_MODE) | RELAY_MODE_PID);
+    tuneState = RELAY_TUNE_DONE;
+    pidReset = true;
+}
+
+/**
+ * @brief Learns the excursions of temperature after switching of the relay
+ *  by hysteresis: the rise over the temperature of switching on and the
+ *  fall below the one of switching off, given in terms of cooling. The
+ *  excursion is measured between two switchings, so the first period after
+ *  a change of mode is skipped. The learned values are set to parameters
+ *  not more often than once per RELAY_LEARN_STORE_SECONDS and are left to
+ *  storeRelayLearned() to be stored into EEPROM.
+ * @param temp - temperature in hundredth of degree.
+ */
+static void learnOvershoot (int temp)
+{
+    if (state != learnState) {
+        if (learnValid && state) {
+            learnOff += (learnTemp - learnPeak - learnOff) >> RELAY_LEARN_BITS;
+        } else if (learnValid) {
+            learnOn += (learnPeak - learnTemp - learnOn) >> RELAY_LEARN_BITS;
+        }
+
+        learnValid = true;
+        learnState = state;
+        learnTemp = learnPeak = temp;
+    } else if (state ? temp > learnPeak : temp < learnPeak) {
+        learnPeak = temp;
+    }
+
+    if (getUptimeInSeconds() >= learnStoreAt) {
+        learnStoreAt = getUptimeInSeconds() + RELAY_LEARN_STORE_SECONDS;
+
+        if (learnOn != getParamById (PARAM_OVERSHOOT_ON)
+                || learnOff != getParamById (PARAM_OVERSHOOT_OFF) ) {
+            setParamById (PARAM_OVERSHOOT_ON, learnOn);
+            setParamById (PARAM_OVERSHOOT_OFF, learnOff);
+            learnStorePending = true;
+        }
+    }
+}
+
+/**
+ * @brief Gets the shift of switching point by the learned excursion when
+ *  the compensation is on. It is limited, so the band between the points
+ *  is kept not narrower than quarter of the hysteresis.
+ * @param learned - excursion in hundredth of degree.
+ * @param hyst - hysteresis in hundredth of degree.
+ * @return shift of switching point in hundredth of degree.
+ */
+static int getLearnShift (int learned, int hyst)
+{
+    int limit = (hyst >> 2) + (hyst >> 3);
+
+    if (learned < 0 || !getParamById (PARAM_OVERSHOOT_COMPENSATION) ) {
+        return 0;
+    }
+
+    return learned < limit ? learned : limit;
 }
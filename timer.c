@@ -18,6 +18,9 @@
 /**
  * Control functions for timer.
  * The TIM4 interrupt (23) is used to get signal on update event.
+ * The interrupt only counts uptime, starts conversions of ADC and refreshes
+ * the display. Buttons, menu and relay are flagged by it and run from the
+ * main loop by runTimerTasks().
  */
 
 #include "timer.h"
@@ -28,7 +31,9 @@
 #include "menu.h"
 #include "relay.h"
 
-#define TICKS_IN_SECOND     500
+#define INTERRUPT_ENABLE    __asm rim __endasm;
+#define INTERRUPT_DISABLE   __asm sim __endasm;
+
 #define BITS_FOR_TICKS      9
 #define BITS_FOR_SECONDS    6
 #define BITS_FOR_MINUTES    6
@@ -47,6 +52,12 @@
  * 31      26       21         15         9         0
  */
 static unsigned long uptime;
+// Seconds since reset as a plain counter for measuring of intervals
+static volatile unsigned long seconds;
+// Work deferred to the main loop: ticks for buttons, menu and relay
+static volatile unsigned char pendingTicks;
+static volatile bool menuPending;
+static volatile bool relayPending;
 
 /**
  * @brief Initialize timer's configuration registers and reset uptime.
@@ -55,7 +66,7 @@ void initTimer()
 {
     CLK_CKDIVR = 0x00;  // Set the frequency to 16 MHz
     TIM4_PSCR = 0x07;   // CLK / 128 = 125KHz
-    TIM4_ARR = 0xFA;    // 125KHz /  250(0xFA) = 500Hz
+    TIM4_ARR = 0xF9;    // 125KHz / (249(0xF9) + 1) = 500Hz
     TIM4_IER = 0x01;    // Enable interrupt on update event
     TIM4_CR1 = 0x05;    // Enable timer
     resetUptime();
@@ -67,6 +78,9 @@ void initTimer()
 void resetUptime()
 {
     uptime = 0;
+    seconds = 0;
+    pendingTicks = 0;
+    menuPending = relayPending = false;
 }
 
 /**
@@ -98,6 +112,24 @@ unsigned char getUptimeSeconds()
     return (unsigned char) ( (uptime >> SECONDS_FIRST_BIT) & BITMASK (BITS_FOR_SECONDS) );
 }
 
+/**
+ * @brief Gets time being passed since last reset in seconds. Unlike the
+ *  parts of uptime counter it does not wrap, so it is suitable to measure
+ *  intervals. The counter is read again if the interrupt has changed it
+ *  in the middle.
+ * @return amount of seconds.
+ */
+unsigned long getUptimeInSeconds()
+{
+    unsigned long val;
+
+    do {
+        val = seconds;
+    } while (val != seconds);
+
+    return val;
+}
+
 /**
  * @brief Gets minutes part of time being passed since last reset.
  * @return minutes part of uptime.
@@ -125,6 +157,37 @@ unsigned char getUptimeDays()
     return (unsigned char) ( (uptime >> DAYS_FIRST_BIT) & BITMASK (BITS_FOR_DAYS) );
 }
 
+/**
+ * @brief Runs the work flagged by TIM4_UPD_handler(): transitions of
+ *  buttons for each tick passed, menu and relay. It is called from the
+ *  main loop, so writing of EEPROM and the calculations of control don't
+ *  delay the interrupts and the display refresh.
+ */
+void runTimerTasks()
+{
+    unsigned char ticks;
+
+    INTERRUPT_DISABLE
+    ticks = pendingTicks;
+    pendingTicks = 0;
+    INTERRUPT_ENABLE
+
+    // Updating buttons' transition for Menu
+    for (; ticks > 0; ticks--) {
+        transitMenu();
+    }
+
+    if (menuPending) {
+        menuPending = false;
+        refreshMenu();
+    }
+
+    if (relayPending) {
+        relayPending = false;
+        refreshRelay();
+    }
+}
+
 /**
  * @brief This function is timer's interrupt request handler
  * so keep it small and fast as much as possible.
@@ -133,9 +196,10 @@ void TIM4_UPD_handler() __interrupt (23)
 {
     TIM4_SR &= ~TIM_SR1_UIF; // Reset flag
 
-    if ( ( (unsigned int) (uptime & BITMASK (BITS_FOR_TICKS) ) ) >= TICKS_IN_SECOND) {
+    if ( ( (unsigned int) (uptime & BITMASK (BITS_FOR_TICKS) ) ) >= TIMER_TICKS_IN_SECOND) {
         uptime &= NBITMASK (SECONDS_FIRST_BIT);
         uptime += (unsigned long) 1 << SECONDS_FIRST_BIT;
+        seconds++;
 
         // Increment minutes count when 60 seconds have passed.
         if ( ( (unsigned char) (uptime >> SECONDS_FIRST_BIT) & BITMASK (BITS_FOR_SECONDS) ) == 60) {
@@ -158,17 +222,18 @@ void TIM4_UPD_handler() __interrupt (23)
 
     uptime++;
 
-    // Updating buttons' transition for Menu
-    transitMenu();
+    if (pendingTicks < 0xFF) {
+        pendingTicks++;
+    }
 
-    // Try not to call all refresh functions at once.
+    // Try not to call all refresh functions at once. The relay is called
+    // TIMER_RELAY_IN_SECOND times per second of uptime.
     if ( ( (unsigned char) getUptimeTicks() & 0x0F) == 1) {
-        refreshMenu();
-    } else if ( ( (unsigned char) getUptimeTicks() & 0xFF) == 2) {
-        startADC();
-    } else if ( ( (unsigned char) getUptimeTicks() & 0xFF) == 3) {
-        refreshRelay();
+        menuPending = true;
+    } else if (getUptimeTicks() % (TIMER_TICKS_IN_SECOND / TIMER_RELAY_IN_SECOND) == 3) {
+        relayPending = true;
     }
 
+    refreshADC();
     refreshDisplay();
 }
@@ -0,0 +1,185 @@
+/*
+ * This file is part of the W1209 firmware replacement project
+ * (https://github.com/mister-grumbler/w1209-firmware).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Host-side generator of the correction curve image for the data EEPROM.
+ * It is built and run by "make curve", the output is written into
+ * Build/curve.ihx which is to be written by the programmer into EEPROM,
+ * e.g. stm8flash -c stlinkv2 -p stm8s003f3 -s eeprom -w Build/curve.ihx
+ * Only the bytes of the curve are written, the parameters are kept.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "eeprom.h"
+
+/*
+ * Usage: adccurve curve.csv
+ *
+ * The curve is 2 to ADC_CURVE_SIZE points, one per line: temperature
+ * measured by the thermostat and the actual one in degrees of Celsius
+ * separated by comma. Empty lines and lines starting with '#' are skipped.
+ * The measured temperature is taken with the default calibration, that is
+ * before the curve is written or with an empty one.
+ */
+
+/* Layout of the curve is shared with params.c */
+#define ADC_CURVE_SIZE      EEPROM_CURVE_SIZE
+#define ADC_CURVE_BYTES     EEPROM_CURVE_BYTES
+
+/* Bytes per data record of Intel HEX */
+#define IHX_RECORD_SIZE     16
+
+static int curveTemp[ADC_CURVE_SIZE];
+static int curveCorrection[ADC_CURVE_SIZE];
+static unsigned int curveSize;
+
+/**
+ * @brief Prints the message with location in the curve and exits.
+ * @param path
+ * @param line
+ * @param message
+ */
+static void fail (const char* path, unsigned int line, const char* message)
+{
+    fprintf (stderr, "%s:%u: %s\n", path, line, message);
+    exit (1);
+}
+
+/**
+ * @brief Loads the curve from CSV file, the points are sorted by measured
+ *  temperature and converted to tenth of degrees.
+ * @param path
+ */
+static void loadCurve (const char* path)
+{
+    unsigned int line = 0;
+    char buffer[128];
+    FILE* file;
+
+    file = fopen (path, "r");
+
+    if (file == NULL) {
+        fail (path, 0, "can not be opened");
+    }
+
+    while (fgets (buffer, sizeof buffer, file) != NULL) {
+        const char* c = buffer;
+        double measured, actual;
+        int t, d;
+        unsigned int i;
+
+        line++;
+
+        while (*c == ' ' || *c == '\t') {
+            c++;
+        }
+
+        if (*c == '#' || *c == '\n' || *c == '\r' || *c == 0) {
+            continue;
+        }
+
+        if (sscanf (c, "%lf , %lf", &measured, &actual) != 2) {
+            fail (path, line, "expected measured,actual");
+        }
+
+        if (curveSize == ADC_CURVE_SIZE) {
+            fail (path, line, "too many points");
+        }
+
+        t = (int) lround (measured * 10);
+        d = (int) lround (actual * 10) - t;
+
+        if (t < -999 || t > 1999) {
+            fail (path, line, "temperature is out of range");
+        }
+
+        if (d < -128 || d > 127) {
+            fail (path, line, "correction is over 12.7 degrees");
+        }
+
+        // insertion by measured temperature
+        for (i = curveSize; i > 0 && curveTemp[i - 1] > t; i--) {
+            curveTemp[i] = curveTemp[i - 1];
+            curveCorrection[i] = curveCorrection[i - 1];
+        }
+
+        if (i > 0 && curveTemp[i - 1] == t) {
+            fail (path, line, "duplicate temperature");
+        }
+
+        curveTemp[i] = t;
+        curveCorrection[i] = d;
+        curveSize++;
+    }
+
+    fclose (file);
+
+    if (curveSize < 2) {
+        fail (path, line, "at least two points are needed");
+    }
+}
+
+/**
+ * @brief Prints the usage and exits.
+ */
+static void usage()
+{
+    fprintf (stderr, "usage: adccurve curve.csv\n");
+    exit (1);
+}
+
+int main (int argc, char* argv[])
+{
+    unsigned char image[ADC_CURVE_BYTES] = {0};
+    unsigned int i, j;
+
+    if (argc != 2) {
+        usage();
+    }
+
+    loadCurve (argv[1]);
+
+    // size, temperatures (big-endian int) and corrections (signed char)
+    image[0] = (unsigned char) curveSize;
+
+    for (i = 0; i < curveSize; i++) {
+        image[1 + i * 2] = (unsigned char) ( (curveTemp[i] >> 8) & 0xFF);
+        image[2 + i * 2] = (unsigned char) (curveTemp[i] & 0xFF);
+        image[1 + ADC_CURVE_SIZE * 2 + i] = (unsigned char) (curveCorrection[i] & 0xFF);
+    }
+
+    for (i = 0; i < ADC_CURVE_BYTES; i += IHX_RECORD_SIZE) {
+        unsigned int addr = EEPROM_BASE_ADDR + EEPROM_CURVE_OFFSET + i;
+        unsigned int n = ADC_CURVE_BYTES - i < IHX_RECORD_SIZE ? ADC_CURVE_BYTES - i : IHX_RECORD_SIZE;
+        unsigned int sum = n + (addr >> 8) + (addr & 0xFF);
+
+        printf (":%02X%04X00", n, addr);
+
+        for (j = 0; j < n; j++) {
+            printf ("%02X", image[i + j]);
+            sum += image[i + j];
+        }
+
+        printf ("%02X\n", (0x100 - (sum & 0xFF) ) & 0xFF);
+    }
+
+    printf (":00000001FF\n");
+
+    return 0;
+}
@@ -0,0 +1,921 @@
+/*
+ * This file is part of the W1209 firmware replacement project
+ * (https://github.com/mister-grumbler/w1209-firmware).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Host-side generator of the lookup tables used by adc.c.
+ * It is built and run by the Makefile, the output is written into
+ * Build/adctable.h. The tables are only defined where ADCTABLE_DATA is
+ * defined before the include (adc.c), others get the constants only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Usage: adctable [-r R2] [-e engine] [-q bound] profile.csv ...
+ *   -r  resistance of the divider resistor R2 in ohm (default 20000)
+ *   -e  conversion engine of adc.c (default table):
+ *       table - piecewise-linear interpolation of the lookup tables, 788
+ *               bytes per profile;
+ *       poly  - polynomial in log2 (RT / R2) fitted to the tables, 28 bytes
+ *               per profile at cost of longer calculation;
+ *       quad  - quadratic interpolation over a few knots of the tables,
+ *               about 90 bytes per profile.
+ *   -q  maximum deviation of quadratic engine from the tables in tenth of
+ *       degree, the knots are placed to keep it (default 1)
+ *
+ * Each profile is a R-T curve of the NTC thermistor, one row per line:
+ * temperature in degrees of Celsius and resistance in ohm separated by
+ * comma. Empty lines and lines starting with '#' are skipped. The profiles
+ * are numbered in order of command line, the active one is selected by
+ * parameter at runtime. All of them are resampled to whole degrees over
+ * the range which is covered by each one.
+ *
+ * The ADC of STM8S003 is 10 bits only, adc.c reads and packs its registers
+ * that way, so the resolution is fixed.
+ */
+
+#define ADC_PROFILES_MAX    8
+#define ADC_CSV_ROWS_MAX    512
+/* Resolution of the ADC in bits */
+#define ADC_RESOLUTION_BITS 10
+/* The segment index of adc.c is 8 bits wide. */
+#define ADC_RAW_32K_MAX     256
+
+static double divider = 20000;
+static const char* engine = "table";
+static int quadBound = 1;
+
+static double csvTemp[ADC_PROFILES_MAX][ADC_CSV_ROWS_MAX];
+static double csvRes[ADC_PROFILES_MAX][ADC_CSV_ROWS_MAX];
+static unsigned int csvRows[ADC_PROFILES_MAX];
+
+static unsigned int profiles[ADC_PROFILES_MAX][ADC_RAW_32K_MAX];
+static unsigned int profileCount;
+static unsigned int tableSize;
+static int tableTop;
+
+/**
+ * @brief Prints the message with location in the profile and exits.
+ * @param path
+ * @param line
+ * @param message
+ */
+static void fail (const char* path, unsigned int line, const char* message)
+{
+    fprintf (stderr, "%s:%u: %s\n", path, line, message);
+    exit (1);
+}
+
+/**
+ * @brief Loads R-T curve of the profile from CSV file, the rows are
+ *  sorted by temperature from the highest one.
+ * @param path
+ */
+static void loadProfile (const char* path)
+{
+    double* temp = csvTemp[profileCount];
+    double* res = csvRes[profileCount];
+    unsigned int n = 0, line = 0;
+    char buffer[128];
+    FILE* file;
+
+    if (profileCount == ADC_PROFILES_MAX) {
+        fail (path, 0, "too many profiles");
+    }
+
+    file = fopen (path, "r");
+
+    if (file == NULL) {
+        fail (path, 0, "can not be opened");
+    }
+
+    while (fgets (buffer, sizeof buffer, file) != NULL) {
+        const char* c = buffer;
+        double t, r;
+        unsigned int i;
+
+        line++;
+
+        while (*c == ' ' || *c == '\t') {
+            c++;
+        }
+
+        if (*c == '#' || *c == '\n' || *c == '\r' || *c == 0) {
+            continue;
+        }
+
+        if (sscanf (c, "%lf , %lf", &t, &r) != 2 || r <= 0) {
+            fail (path, line, "expected temperature,resistance");
+        }
+
+        if (n == ADC_CSV_ROWS_MAX) {
+            fail (path, line, "too many rows");
+        }
+
+        // insertion by temperature
+        for (i = n; i > 0 && temp[i - 1] < t; i--) {
+            temp[i] = temp[i - 1];
+            res[i] = res[i - 1];
+        }
+
+        if (i > 0 && temp[i - 1] == t) {
+            fail (path, line, "duplicate temperature");
+        }
+
+        temp[i] = t;
+        res[i] = r;
+        n++;
+    }
+
+    fclose (file);
+
+    if (n < 2) {
+        fail (path, line, "at least two rows are needed");
+    }
+
+    csvRows[profileCount++] = n;
+}
+
+/**
+ * @brief Resistance of the profile at given temperature, ln (R) is
+ *  interpolated linearly over 1 / T between the rows of the curve.
+ * @param p
+ * @param t
+ *  temperature in degrees of Celsius, within the range of the curve.
+ * @return resistance in ohm.
+ */
+static double resistance (unsigned int p, int t)
+{
+    const double* temp = csvTemp[p];
+    const double* res = csvRes[p];
+    unsigned int i = 0;
+    double x, xa, xb;
+
+    while (temp[i + 1] > t) {
+        i++;
+    }
+
+    if (temp[i] == t) {
+        return res[i];
+    }
+
+    if (temp[i + 1] == t) {
+        return res[i + 1];
+    }
+
+    x = 1 / (t + 273.15);
+    xa = 1 / (temp[i] + 273.15);
+    xb = 1 / (temp[i + 1] + 273.15);
+
+    return exp (log (res[i]) + (log (res[i + 1]) - log (res[i]) ) * (x - xa) / (xb - xa) );
+}
+
+/**
+ * @brief Resamples all of the profiles into the raw ADC 32k lookup tables
+ *  with one knot per degree over the range which is common for them.
+ */
+static void buildTables()
+{
+    int top = 1000, bottom = -1000;
+    unsigned int i, p;
+
+    for (p = 0; p < profileCount; p++) {
+        int high = (int) floor (csvTemp[p][0]);
+        int low = (int) ceil (csvTemp[p][csvRows[p] - 1]);
+
+        if (high < top) {
+            top = high;
+        }
+
+        if (low > bottom) {
+            bottom = low;
+        }
+    }
+
+    if (top - bottom + 1 < 3 || top - bottom + 1 > ADC_RAW_32K_MAX) {
+        fprintf (stderr, "adctable: common range %d..%d of profiles is not usable\n", bottom, top);
+        exit (1);
+    }
+
+    tableTop = top;
+    tableSize = top - bottom + 1;
+
+    for (p = 0; p < profileCount; p++) {
+        for (i = 0; i < tableSize; i++) {
+            double rt = resistance (p, top - (int) i);
+
+            // the same rounding as it was done by compiler for typed in tables
+            profiles[p][i] = (unsigned int) (32768.f * rt / (divider + rt) );
+
+            if (i > 0 && profiles[p][i] <= profiles[p][i - 1]) {
+                fprintf (stderr, "adctable: profile %u is not monotonic at %d C\n", p, top - (int) i);
+                exit (1);
+            }
+        }
+    }
+}
+
+/*
+ * The knots are stored as second differences, with the value and the first
+ * difference kept at each (1 << ADC_BLOCK_BITS) knot. So the decoder never
+ * walks more than a block to get any knot.
+ */
+#define ADC_BLOCK_BITS      4
+#define ADC_BLOCKS          ( ( (tableSize - 2) >> ADC_BLOCK_BITS) + 1)
+
+/* Width of coarse index bucket is (1 << ADC_INDEX_SHIFT) of val32k. */
+#define ADC_INDEX_SHIFT     7
+#define ADC_INDEX_SIZE      (32768 >> ADC_INDEX_SHIFT)
+
+/* Fixed-point scale of the reciprocal slope, 10 * 2^12 * delta fits 16 bits. */
+#define ADC_SLOPE_SHIFT     12
+
+/*
+ * The polynomial is evaluated by Horner's rule with 32 bit accumulator and
+ * log2 (RT / R2) in Q12. The coefficient of L^k is stored in units of
+ * 2^-(ADC_POLY_SHIFT * (k + 1)) tenth of degree, so each step shifts the
+ * product by (12 + ADC_POLY_SHIFT) and it never exceeds 31 bits.
+ */
+#define ADC_POLY_DEGREE     5
+#define ADC_POLY_SHIFT      4
+
+/* The mantissa of log2 is interpolated over 2^ADC_LOG2_BITS segments. */
+#define ADC_LOG2_BITS       5
+#define ADC_LOG2_SIZE       ( (1 << ADC_LOG2_BITS) + 1)
+
+
+/*
+ * The quadratic engine splits the tables into segments of whole degrees,
+ * each one is made as long as the fit keeps within the bound given by -q
+ * from the linear interpolation. Within the segment from knot v0 of T0:
+ *   T = T0 - d * (slope + d * curve / 2^ADC_QUAD_CURVE_SHIFT) / 2^16,
+ * where d = val32k - v0.
+ */
+#define ADC_QUAD_CURVE_SHIFT    8
+
+/**
+ * @brief Linear interpolation of the lookup table which is rounded down
+ *  the same way as the table engine does.
+ * @param rawAdc32k
+ * @param i
+ *  index of the left bound of the segment which contains val32k.
+ * @param val32k
+ * @return temperature in tenth of degrees of Celsius.
+ */
+static int linearTemperature (const unsigned int* rawAdc32k, unsigned int i,
+                              unsigned int val32k)
+{
+    unsigned int d = rawAdc32k[i + 1] - rawAdc32k[i];
+
+    return (tableTop - (int) i - 1) * 10
+           + (int) ( (rawAdc32k[i + 1] - val32k) * 10 / d);
+}
+
+static unsigned int log2Table[ADC_LOG2_SIZE];
+
+/**
+ * @brief Fixed-point log2 as it is calculated by adc.c.
+ * @param x
+ *  in range 1 .. 0xFFFF.
+ * @return log2 (x) in Q15.
+ */
+static long log2Q15 (unsigned int x)
+{
+    unsigned char n = 15;
+    unsigned char i;
+    unsigned int r;
+
+    while (! (x & 0x8000) ) {
+        x <<= 1;
+        n--;
+    }
+
+    i = (x >> (15 - ADC_LOG2_BITS) ) & ( (1 << ADC_LOG2_BITS) - 1);
+    r = x & ( (1 << (15 - ADC_LOG2_BITS) ) - 1);
+
+    return ( (long) n << 15) + log2Table[i]
+           + ( ( (unsigned long) (log2Table[i + 1] - log2Table[i]) * r) >> (15 - ADC_LOG2_BITS) );
+}
+
+/**
+ * @brief Fixed-point polynomial conversion as it is calculated by adc.c.
+ *  Exits when any product does not fit 32 bits.
+ * @param poly
+ * @param val32k
+ * @return temperature in tenth of degrees of Celsius.
+ */
+static int polyTemperature (const long* poly, unsigned int val32k)
+{
+    long x = (log2Q15 (val32k) - log2Q15 (32768 - val32k) ) >> 3;
+    long acc = poly[ADC_POLY_DEGREE];
+    int k;
+
+    for (k = ADC_POLY_DEGREE - 1; k >= 0; k--) {
+        long long product = (long long) acc * x;
+
+        if (product > 0x7FFFFFFFLL || product < -0x7FFFFFFFLL) {
+            fprintf (stderr, "adctable: polynomial overflows at %u\n", val32k);
+            exit (1);
+        }
+
+        acc = poly[k] + (long) (product >> (12 + ADC_POLY_SHIFT) );
+    }
+
+    return (int) ( (acc + (1 << (ADC_POLY_SHIFT - 1) ) ) >> ADC_POLY_SHIFT);
+}
+
+/**
+ * @brief Least squares fit of the temperature over log2 (RT / R2) of
+ *  the knots of the lookup table.
+ * @param rawAdc32k
+ * @param poly
+ *  is set to the fixed-point coefficients.
+ */
+static void fitPolynomial (const unsigned int* rawAdc32k, long* poly)
+{
+    long double a[ADC_POLY_DEGREE + 1][ADC_POLY_DEGREE + 2] = { { 0 } };
+    long double c[ADC_POLY_DEGREE + 1];
+    int i, j, k;
+
+    // normal equations
+    for (i = 0; i < (int) tableSize; i++) {
+        long double x = log2l ( (long double) rawAdc32k[i] / (32768 - rawAdc32k[i]) );
+        long double t = (tableTop - i) * 10;
+
+        for (j = 0; j <= ADC_POLY_DEGREE; j++) {
+            for (k = 0; k <= ADC_POLY_DEGREE; k++) {
+                a[j][k] += powl (x, j + k);
+            }
+
+            a[j][ADC_POLY_DEGREE + 1] += powl (x, j) * t;
+        }
+    }
+
+    // Gauss-Jordan elimination with partial pivoting
+    for (j = 0; j <= ADC_POLY_DEGREE; j++) {
+        int pivot = j;
+
+        for (i = j + 1; i <= ADC_POLY_DEGREE; i++) {
+            if (fabsl (a[i][j]) > fabsl (a[pivot][j]) ) {
+                pivot = i;
+            }
+        }
+
+        for (k = 0; k <= ADC_POLY_DEGREE + 1; k++) {
+            long double t = a[j][k];
+            a[j][k] = a[pivot][k];
+            a[pivot][k] = t;
+        }
+
+        for (i = 0; i <= ADC_POLY_DEGREE; i++) {
+            if (i != j) {
+                long double f = a[i][j] / a[j][j];
+
+                for (k = j; k <= ADC_POLY_DEGREE + 1; k++) {
+                    a[i][k] -= f * a[j][k];
+                }
+            }
+        }
+    }
+
+    for (k = 0; k <= ADC_POLY_DEGREE; k++) {
+        c[k] = a[k][ADC_POLY_DEGREE + 1] / a[k][k];
+        poly[k] = lroundl (ldexpl (c[k], ADC_POLY_SHIFT * (k + 1) ) );
+    }
+}
+
+/**
+ * @brief Prints the coefficients of polynomial engine with maximum
+ *  deviation from the piecewise-linear interpolation of lookup tables.
+ */
+static void printPolynomial()
+{
+    long poly[ADC_PROFILES_MAX][ADC_POLY_DEGREE + 1];
+    unsigned int i, p, k;
+
+    for (i = 0; i < ADC_LOG2_SIZE; i++) {
+        log2Table[i] = (unsigned int) lround (ldexp (log2 (1.0 + ldexp (i, -ADC_LOG2_BITS) ), 15) );
+    }
+
+    printf ("#define ADC_POLYNOMIAL\n");
+    printf ("#define ADC_POLY_DEGREE %d\n", ADC_POLY_DEGREE);
+    printf ("#define ADC_POLY_SHIFT %d\n", ADC_POLY_SHIFT);
+    printf ("#define ADC_LOG2_BITS %d\n\n", ADC_LOG2_BITS);
+    printf ("#ifdef ADCTABLE_DATA\n\n");
+
+    printf ("// Mantissa of log2 (1 + i / 2^ADC_LOG2_BITS) in Q15.\n");
+    printf ("const unsigned int adcLog2[%d] = {", ADC_LOG2_SIZE);
+
+    for (i = 0; i < ADC_LOG2_SIZE; i++) {
+        printf ("%s%5u,", (i % 8) ? " " : "\n    ", log2Table[i]);
+    }
+
+    printf ("\n};\n\n");
+
+    printf ("// Range of val32k covered by the fit, the result is clamped to it.\n");
+    printf ("const unsigned int adcPolyRange[][2] = {\n");
+
+    for (p = 0; p < profileCount; p++) {
+        printf ("    { %5u, %5u },\n", profiles[p][0], profiles[p][tableSize - 1]);
+    }
+
+    printf ("};\n\n");
+
+    printf ("// Coefficients of L^k in 2^-(ADC_POLY_SHIFT * (k + 1)) tenth of degree.\n");
+    printf ("const long adcPoly[][%d] = {\n", ADC_POLY_DEGREE + 1);
+
+    for (p = 0; p < profileCount; p++) {
+        int maxError = 0;
+        unsigned int v;
+
+        fitPolynomial (profiles[p], poly[p]);
+
+        for (i = 0; i < tableSize - 1; i++) {
+            for (v = profiles[p][i]; v < profiles[p][i + 1]; v++) {
+                int error = abs (polyTemperature (poly[p], v)
+                                 - linearTemperature (profiles[p], i, v) );
+
+                if (error > maxError) {
+                    maxError = error;
+                }
+            }
+        }
+
+        printf ("    // max deviation from the table is %d tenth of degree\n    {", maxError);
+
+        for (k = 0; k <= ADC_POLY_DEGREE; k++) {
+            printf (" %ld,", poly[p][k]);
+        }
+
+        printf (" },\n");
+    }
+
+    printf ("};\n\n");
+}
+
+/**
+ * @brief Quadratic interpolation within the segment as it is calculated
+ *  by adc.c. Exits when the product does not fit 32 bits.
+ * @param temp
+ *  temperature of the first knot of segment in degrees of Celsius.
+ * @param d
+ *  distance of val32k from the first knot of segment.
+ * @param slope
+ * @param curve
+ * @return temperature in tenth of degrees of Celsius.
+ */
+static int quadTemperature (int temp, unsigned int d, long slope, long curve)
+{
+    long q = slope + ( ( (long) d * curve) >> ADC_QUAD_CURVE_SHIFT);
+    long long product = (long long) d * q;
+
+    if (product + 0x8000 > 0x7FFFFFFFLL || product < -0x7FFFFFFFLL) {
+        fprintf (stderr, "adctable: quadratic segment overflows at %u\n", d);
+        exit (1);
+    }
+
+    return temp * 10 - (int) ( (product + 0x8000) >> 16);
+}
+
+/**
+ * @brief Least squares fit of the segment between knots i and j of the
+ *  lookup table, which passes through the knot i.
+ * @param rawAdc32k
+ * @param i
+ * @param j
+ * @param slope
+ *  is set to the fixed-point slope at the knot i.
+ * @param curve
+ *  is set to the fixed-point curvature.
+ * @return maximum deviation from the linear interpolation within segment.
+ */
+static int fitSegment (const unsigned int* rawAdc32k, unsigned int i, unsigned int j,
+                       long* slope, long* curve)
+{
+    long double s11 = 0, s12 = 0, s22 = 0, r1 = 0, r2 = 0;
+    int maxError = 0;
+    unsigned int k, v;
+
+    for (k = i + 1; k <= j; k++) {
+        long double d = rawAdc32k[k] - rawAdc32k[i];
+        long double t = (k - i) * 10;
+
+        s11 += d * d;
+        s12 += d * d * d;
+        s22 += d * d * d * d;
+        r1 += d * t;
+        r2 += d * d * t;
+    }
+
+    if (j == i + 1) {
+        *slope = lroundl (ldexpl (r1 / s11, 16) );
+        *curve = 0;
+    } else {
+        long double det = s11 * s22 - s12 * s12;
+
+        *slope = lroundl (ldexpl ( (r1 * s22 - r2 * s12) / det, 16) );
+        *curve = lroundl (ldexpl ( (s11 * r2 - s12 * r1) / det, 16 + ADC_QUAD_CURVE_SHIFT) );
+    }
+
+    for (k = i; k < j; k++) {
+        for (v = rawAdc32k[k]; v < rawAdc32k[k + 1]; v++) {
+            int error = abs (quadTemperature (tableTop - (int) i, v - rawAdc32k[i],
+                                              *slope, *curve)
+                             - linearTemperature (rawAdc32k, k, v) );
+
+            if (error > maxError) {
+                maxError = error;
+            }
+        }
+    }
+
+    return maxError;
+}
+
+/**
+ * @brief Prints the knots and coefficients of quadratic engine with
+ *  maximum deviation from the piecewise-linear interpolation of lookup
+ *  tables.
+ */
+static void printQuadratic()
+{
+    unsigned char knots[ADC_PROFILES_MAX][ADC_RAW_32K_MAX];
+    long slopes[ADC_PROFILES_MAX][ADC_RAW_32K_MAX];
+    long curves[ADC_PROFILES_MAX][ADC_RAW_32K_MAX];
+    int errors[ADC_PROFILES_MAX];
+    unsigned int counts[ADC_PROFILES_MAX];
+    unsigned int size = 0;
+    unsigned int i, p;
+
+    // Greedy placement, each segment is extended while it keeps the bound
+    for (p = 0; p < profileCount; p++) {
+        unsigned int n = 0;
+
+        errors[p] = 0;
+        knots[p][0] = 0;
+
+        while (knots[p][n] < tableSize - 1) {
+            unsigned int first = knots[p][n];
+            unsigned int last = first + 1;
+            int error;
+
+            while (last < tableSize - 1
+                    && fitSegment (profiles[p], first, last + 1, &slopes[p][n], &curves[p][n])
+                    <= quadBound) {
+                last++;
+            }
+
+            error = fitSegment (profiles[p], first, last, &slopes[p][n], &curves[p][n]);
+
+            if (slopes[p][n] > 0x7FFF || curves[p][n] > 0x7FFF || curves[p][n] < -0x8000) {
+                fprintf (stderr, "adctable: profile %u segment %u does not fit 16 bits\n", p, n);
+                exit (1);
+            }
+
+            if (error > errors[p]) {
+                errors[p] = error;
+            }
+
+            knots[p][++n] = last;
+        }
+
+        counts[p] = n;
+
+        if (n + 1 > size) {
+            size = n + 1;
+        }
+    }
+
+    printf ("#define ADC_QUADRATIC\n");
+    printf ("#define ADC_QUAD_SIZE %u\n", size);
+    printf ("#define ADC_QUAD_CURVE_SHIFT %d\n\n", ADC_QUAD_CURVE_SHIFT);
+    printf ("#ifdef ADCTABLE_DATA\n\n");
+
+    // The shorter tables are padded by the last knot, so the search never
+    // stops on padding as val32k is below it.
+    printf ("// Knots of the segments, the last one bounds the table.\n");
+    printf ("const unsigned int rawAdc32kQuadKnot[][%u] = {\n", size);
+
+    for (p = 0; p < profileCount; p++) {
+        printf ("    // %u segments, max deviation from the table is %d tenth of degree\n    {",
+                counts[p], errors[p]);
+
+        for (i = 0; i < size; i++) {
+            printf ("%s%5u,", (i % 8) ? " " : "\n        ",
+                    profiles[p][knots[p][i < counts[p] ? i : counts[p]]]);
+        }
+
+        printf ("\n    },\n");
+    }
+
+    printf ("};\n\n");
+
+    printf ("// Temperature of the knots in degrees of Celsius.\n");
+    printf ("const %s rawAdc32kQuadTemp[][%u] = {\n",
+            tableTop < 128 && tableTop - (int) tableSize >= -128 ? "signed char" : "int", size);
+
+    for (p = 0; p < profileCount; p++) {
+        printf ("    {");
+
+        for (i = 0; i < size; i++) {
+            printf ("%s%5d,", (i % 8) ? " " : "\n        ",
+                    tableTop - knots[p][i < counts[p] ? i : counts[p]]);
+        }
+
+        printf ("\n    },\n");
+    }
+
+    printf ("};\n\n");
+
+    printf ("// Tenth of degree per count at the first knot of segment in 1/2^16 units.\n");
+    printf ("const int rawAdc32kQuadSlope[][%u] = {\n", size - 1);
+
+    for (p = 0; p < profileCount; p++) {
+        printf ("    {");
+
+        for (i = 0; i < size - 1; i++) {
+            printf ("%s%6ld,", (i % 8) ? " " : "\n        ", i < counts[p] ? slopes[p][i] : 0);
+        }
+
+        printf ("\n    },\n");
+    }
+
+    printf ("};\n\n");
+
+    printf ("// Change of slope per count in 1/2^(16 + ADC_QUAD_CURVE_SHIFT) units.\n");
+    printf ("const int rawAdc32kQuadCurve[][%u] = {\n", size - 1);
+
+    for (p = 0; p < profileCount; p++) {
+        printf ("    {");
+
+        for (i = 0; i < size - 1; i++) {
+            printf ("%s%6ld,", (i % 8) ? " " : "\n        ", i < counts[p] ? curves[p][i] : 0);
+        }
+
+        printf ("\n    },\n");
+    }
+
+    printf ("};\n\n");
+}
+
+/**
+ * @brief Finds the segment of the lookup table which contains given value.
+ * @param rawAdc32k
+ * @param val32k
+ * @return index of the left bound of the segment.
+ */
+static unsigned char findSegment (const unsigned int* rawAdc32k, unsigned int val32k)
+{
+    unsigned char i = 0;
+
+    while (i < tableSize - 2 && rawAdc32k[i + 1] <= val32k) {
+        i++;
+    }
+
+    return i;
+}
+
+/**
+ * @brief Prints the compressed lookup tables of the table engine.
+ */
+static void printTables()
+{
+    unsigned int i, p;
+
+    printf ("#define ADC_INDEX_SHIFT %d\n", ADC_INDEX_SHIFT);
+    printf ("#define ADC_SLOPE_SHIFT %d\n", ADC_SLOPE_SHIFT);
+    printf ("#define ADC_BLOCK_BITS %d\n", ADC_BLOCK_BITS);
+    printf ("#define ADC_BLOCKS %u\n\n", ADC_BLOCKS);
+    printf ("#ifdef ADCTABLE_DATA\n\n");
+
+    // The last entry is the value of the last knot, it bounds the table.
+    printf ("// Value of the first knot of each block of the lookup tables.\n");
+    printf ("const unsigned int rawAdc32kBase[][%d] = {\n", ADC_BLOCKS + 1);
+
+    for (p = 0; p < profileCount; p++) {
+        printf ("    {");
+
+        for (i = 0; i < ADC_BLOCKS; i++) {
+            printf ("%s%5u,", (i % 8) ? " " : "\n        ",
+                    profiles[p][i << ADC_BLOCK_BITS]);
+        }
+
+        printf ("%s%5u,\n    },\n", (i % 8) ? " " : "\n        ",
+                profiles[p][tableSize - 1]);
+    }
+
+    printf ("};\n\n");
+
+    printf ("// Distance from the first knot of each block to the next one.\n");
+    printf ("const unsigned int rawAdc32kStep[][%d] = {\n", ADC_BLOCKS);
+
+    for (p = 0; p < profileCount; p++) {
+        printf ("    {");
+
+        for (i = 0; i < ADC_BLOCKS; i++) {
+            printf ("%s%5u,", (i % 8) ? " " : "\n        ",
+                    profiles[p][ (i << ADC_BLOCK_BITS) + 1] - profiles[p][i << ADC_BLOCK_BITS]);
+        }
+
+        printf ("\n    },\n");
+    }
+
+    printf ("};\n\n");
+
+    printf ("// Change of distance to the next knot at each knot of the lookup tables.\n");
+    printf ("const signed char rawAdc32kDiff[][%d] = {\n", tableSize - 1);
+
+    for (p = 0; p < profileCount; p++) {
+        printf ("    {");
+
+        for (i = 0; i < tableSize - 1; i++) {
+            int diff = 0;
+
+            if (i > 0) {
+                diff = (int) (profiles[p][i + 1] - profiles[p][i])
+                       - (int) (profiles[p][i] - profiles[p][i - 1]);
+            }
+
+            if (diff < -128 || diff > 127) {
+                fprintf (stderr, "adctable: profile %u knot %u does not fit the encoding\n", p, i);
+                exit (1);
+            }
+
+            printf ("%s%4d,", (i % 8) ? " " : "\n        ", diff);
+        }
+
+        printf ("\n    },\n");
+    }
+
+    printf ("};\n\n");
+
+    printf ("// Left bound of the segment for each (val32k >> ADC_INDEX_SHIFT).\n");
+    printf ("const unsigned char rawAdc32kIndex[][%d] = {\n", ADC_INDEX_SIZE);
+
+    for (p = 0; p < profileCount; p++) {
+        printf ("    {");
+
+        for (i = 0; i < ADC_INDEX_SIZE; i++) {
+            printf ("%s%3u,", (i % 16) ? " " : "\n        ",
+                    findSegment (profiles[p], i << ADC_INDEX_SHIFT) );
+        }
+
+        printf ("\n    },\n");
+    }
+
+    printf ("};\n\n");
+
+    // Rounded up, so the result is never below the exact 10 * delta / denom.
+    printf ("// Tenth of degree per count of each segment in 1/2^ADC_SLOPE_SHIFT units.\n");
+    printf ("const unsigned int rawAdc32kSlope[][%d] = {\n", tableSize - 1);
+
+    for (p = 0; p < profileCount; p++) {
+        printf ("    {");
+
+        for (i = 0; i < tableSize - 1; i++) {
+            unsigned int denom = profiles[p][i + 1] - profiles[p][i];
+            printf ("%s%5u,", (i % 8) ? " " : "\n        ",
+                    ( (10U << ADC_SLOPE_SHIFT) + denom - 1) / denom);
+        }
+
+        printf ("\n    },\n");
+    }
+
+    printf ("};\n\n");
+}
+
+/**
+ * @brief Prints the limits of conversion for the fault of probe: halfway
+ *  between the ends of the tables and the ends of ADC range, so the readings
+ *  over the tables are never taken as open or shorted probe. Exits when the
+ *  divider R2 leaves no room for them.
+ */
+static void printFaultLimits()
+{
+    unsigned int p, high = 0, low = 0xFFFF;
+    unsigned int full = 1 << ADC_RESOLUTION_BITS;
+
+    for (p = 0; p < profileCount; p++) {
+        unsigned int top = (profiles[p][tableSize - 1] + (1 << (15 - ADC_RESOLUTION_BITS) ) - 1)
+                           >> (15 - ADC_RESOLUTION_BITS);
+        unsigned int bottom = profiles[p][0] >> (15 - ADC_RESOLUTION_BITS);
+
+        if (top > high) {
+            high = top;
+        }
+
+        if (bottom < low) {
+            low = bottom;
+        }
+    }
+
+    // An open probe reads full - 1, a shorted one reads 0
+    if (high + 2 >= full - 1 || low < 2) {
+        fprintf (stderr, "adctable: tables reach %u..%u of ADC, R2 = %.0f ohm leaves no room "
+                 "for fault limits\n", low, high, divider);
+        exit (1);
+    }
+
+    printf ("// Conversions over the tables are faults of probe\n");
+    printf ("#define ADC_FAULT_OPEN_RAW %u\n", (high + full) >> 1);
+    printf ("#define ADC_FAULT_SHORT_RAW %u\n\n", low >> 1);
+}
+
+/**
+ * @brief Prints the usage and exits.
+ */
+static void usage()
+{
+    fprintf (stderr, "usage: adctable [-r R2] [-e table|poly|quad] [-q bound] profile.csv ...\n");
+    exit (1);
+}
+
+int main (int argc, char* argv[])
+{
+    unsigned int i, p, worst = 0xFFFF;
+    int arg;
+
+    for (arg = 1; arg < argc && argv[arg][0] == '-'; arg += 2) {
+        if (arg + 1 == argc || argv[arg][1] == 0 || argv[arg][2] != 0) {
+            usage();
+        }
+
+        switch (argv[arg][1]) {
+        case 'r':
+            divider = atof (argv[arg + 1]);
+            break;
+
+        case 'e':
+            engine = argv[arg + 1];
+            break;
+
+        case 'q':
+            quadBound = atoi (argv[arg + 1]);
+            break;
+
+        default:
+            usage();
+        }
+    }
+
+    if (arg == argc || divider <= 0 || quadBound < 1
+            || (strcmp (engine, "table") != 0 && strcmp (engine, "poly") != 0
+                && strcmp (engine, "quad") != 0) ) {
+        usage();
+    }
+
+    for (; arg < argc; arg++) {
+        loadProfile (argv[arg]);
+    }
+
+    buildTables();
+
+    // The least change of val32k per degree in LSB of ADC
+    for (p = 0; p < profileCount; p++) {
+        for (i = 1; i < tableSize; i++) {
+            if (profiles[p][i] - profiles[p][i - 1] < worst) {
+                worst = profiles[p][i] - profiles[p][i - 1];
+            }
+        }
+    }
+
+    printf ("/* Generated by tools/adctable.c, do not edit. */\n\n");
+    printf ("#ifndef ADCTABLE_H\n#define ADCTABLE_H\n\n");
+
+    printf ("// At worst %.2f LSB of %u-bit ADC per degree, R2 = %.0f ohm.\n",
+            worst / (double) (1 << (15 - ADC_RESOLUTION_BITS) ), ADC_RESOLUTION_BITS, divider);
+    printf ("#define ADC_RESOLUTION_BITS %u\n", ADC_RESOLUTION_BITS);
+    printf ("#define ADC_PROFILES %u\n", profileCount);
+    printf ("#define ADC_RAW_32K_TOP %d\n", tableTop);
+    printf ("#define ADC_RAW_32K_SIZE %u\n\n", tableSize);
+    printFaultLimits();
+
+    if (strcmp (engine, "poly") == 0) {
+        printPolynomial();
+    } else if (strcmp (engine, "quad") == 0) {
+        printQuadratic();
+    } else {
+        printTables();
+    }
+
+    printf ("#endif /* ADCTABLE_DATA */\n\n#endif\n");
+
+    return 0;
+}
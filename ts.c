@@ -27,13 +27,26 @@
 #define INTERRUPT_DISABLE   __asm sim __endasm;
 #define WAIT_FOR_INTERRUPT  __asm wfi __endasm;
 
+// Duration of display test ("888") after reset in timer ticks (2 ms),
+// 0 disables the test
+#ifndef DISPLAY_TEST_TICKS
+#define DISPLAY_TEST_TICKS  100
+#endif
+
 /**
  * @brief
  */
 int main()
 {
     static unsigned char* stringBuffer[7];
-    unsigned char paramMsg[] = {'P', '0', 0};
+    unsigned char paramMsg[] = {'P', '0', 0, 0};
+    // Labels of ADC statistics: count, mean, deviation, min (low), max (high)
+    static const unsigned char statLabel[] = {'N', 'A', 'D', 'L', 'H', 'R'};
+    unsigned char statMsg[] = {'N', '-', 0};
+    // Second of uptime of the last snapshot of ADC statistics
+    unsigned char statSecond = 0xFF;
+    // Progress of autotune: the number of relay cycle
+    unsigned char tuneMsg[] = {'A', '-', '0', 0};
 
     initMenu();
     initButtons();
@@ -45,15 +58,38 @@ int main()
 
     INTERRUPT_ENABLE
 
+    // The temperature is already taken by initADC()
+    refreshRelay();
+
     // Loop
     while (true) {
-        if (getUptimeSeconds() > 0) {
+        // The work flagged by interrupts since the last wake-up
+        refreshTemperature();
+        runTimerTasks();
+        storeRelayLearned();
+
+        // The uptime counter is bit-packed, so the ticks are counted from
+        // the seconds and the ticks within the second
+        if (getUptimeInSeconds() * TIMER_TICKS_IN_SECOND + getUptimeTicks()
+                >= DISPLAY_TEST_TICKS) {
             setDisplayTestMode (false, "");
         }
 
-        if (getMenuDisplay() == MENU_ROOT) {
+        if (getMenuDisplay() == MENU_ROOT && getAdcFault() != ADC_FAULT_NONE) {
+            // E-1: open probe, E-2: shorted probe
+            setDisplayStr (getAdcFault() == ADC_FAULT_OPEN ? "E-1" : "E-2");
+        } else if (getMenuDisplay() == MENU_ROOT) {
             int temp = getTemperature();
-            itofpa (temp, (char*) stringBuffer, 0);
+
+            // Three digits show tenth of degree in range -9.9 .. 99.9,
+            // the rest is rounded to whole degrees.
+            if (temp > -100 && temp < 1000) {
+                itofpa (temp, (char*) stringBuffer, 0);
+            } else {
+                int centi = getTemperatureCenti();
+                itofpa ( (centi + (centi < 0 ? -50 : 50) ) / 100, (char*) stringBuffer, 6);
+            }
+
             setDisplayStr ( (char*) stringBuffer);
 
             if (getParamById (PARAM_OVERHEAT_INDICATION) ) {
@@ -71,11 +107,77 @@ int main()
             paramToString (PARAM_THRESHOLD, (char*) stringBuffer);
             setDisplayStr ( (char*) stringBuffer);
         } else if (getMenuDisplay() == MENU_SELECT_PARAM) {
-            paramMsg[1] = '0' + getParamId();
+            itofpa (getParamId(), &paramMsg[1], 6);
             setDisplayStr ( (unsigned char*) &paramMsg);
         } else if (getMenuDisplay() == MENU_CHANGE_PARAM) {
             paramToString (getParamId(), (char*) stringBuffer);
             setDisplayStr ( (char *) stringBuffer);
+        } else if (getMenuDisplay() == MENU_ADC_STATS) {
+            // The label of statistic is shown in turn with its value
+            if (getUptimeSeconds() & 0x01) {
+                statMsg[0] = statLabel[getMenuStat()];
+                setDisplayStr ( (unsigned char*) &statMsg);
+                statSecond = 0xFF;
+            } else {
+                unsigned int val;
+
+                // The snapshot is taken once per shown value instead of
+                // each wake-up of the loop
+                if (statSecond != getUptimeSeconds() ) {
+                    statSecond = getUptimeSeconds();
+                    snapAdcStats();
+                }
+
+                val = getAdcStat (getMenuStat() );
+
+                // The results (sums of 8 conversions) don't fit into three
+                // digits, so the mean and limits are shown in LSB of a
+                // single conversion
+                if (getMenuStat() == ADC_STAT_DEVIATION
+                        || getMenuStat() == ADC_STAT_REJECTED) {
+                    itofpa (val > 999 ? 999 : val, (char*) stringBuffer, 0);
+                } else if (getMenuStat() == ADC_STAT_COUNT) {
+                    itofpa (val, (char*) stringBuffer, 6);
+                } else {
+                    val = (val + 4) >> 3;
+                    itofpa (val > 999 ? 999 : val, (char*) stringBuffer, 6);
+                }
+
+                setDisplayStr ( (char*) stringBuffer);
+            }
+        } else if (getMenuDisplay() == MENU_AUTOTUNE) {
+            if (getRelayTune() == RELAY_TUNE_RUN) {
+                // The number of cycle is shown in turn with the temperature
+                if (getUptimeSeconds() & 0x01) {
+                    tuneMsg[2] = '0' + getRelayTuneCycle();
+                    setDisplayStr ( (unsigned char*) &tuneMsg);
+                } else {
+                    itofpa (getTemperature(), (char*) stringBuffer, 0);
+                    setDisplayStr ( (char*) stringBuffer);
+                }
+            } else if (getRelayTune() == RELAY_TUNE_DONE) {
+                // The gains P15, P16, P17 are shown in turn with the values
+                unsigned char id = PARAM_PID_KP + (getUptimeSeconds() >> 1) % 3;
+
+                if (getUptimeSeconds() & 0x01) {
+                    itofpa (id, &paramMsg[1], 6);
+                    setDisplayStr ( (unsigned char*) &paramMsg);
+                } else {
+                    paramToString (id, (char*) stringBuffer);
+                    setDisplayStr ( (char*) stringBuffer);
+                }
+            } else {
+                setDisplayStr ("A-F");
+            }
+        } else if (getMenuDisplay() == MENU_CALIBRATE_POINT1
+                   || getMenuDisplay() == MENU_CALIBRATE_POINT2) {
+            // The number of point is shown in turn with its reference
+            if (getUptimeSeconds() & 0x01) {
+                setDisplayStr (getMenuDisplay() == MENU_CALIBRATE_POINT1 ? "C-1" : "C-2");
+            } else {
+                itofpa (getMenuCalibration(), (char*) stringBuffer, 0);
+                setDisplayStr ( (char*) stringBuffer);
+            }
         } else {
             setDisplayStr ("ERR");
             setDisplayOff ( (bool) (getUptime() & 0x40) );